@@ -0,0 +1,208 @@
+/**
+ * Algorithmic-complexity check of interpreter hot paths.
+ *
+ * Times every path at input sizes N, 2N, 4N and 8N, and estimates its
+ * growth exponent (1 for linear, 2 for quadratic). Exits with a non-zero
+ * status if any path grows faster than its limit, so that it can gate
+ * a build or a CI job.
+ *
+ * Usage: DSSBenchComplexity [--scale 1.0] [--slack 0.4] [--only <path>]
+ */
+
+#include <cmath>
+#include <functional>
+#include <iostream>
+
+#include "DSS.h"
+
+namespace
+{
+
+struct path_t
+{
+	std::string name;
+
+	/**
+	 * N at scale 1
+	 */
+	std::size_t n;
+
+	/**
+	 * Expected growth exponent
+	 */
+	double exponent;
+
+	/**
+	 * Builds the input of size n, then returns the work to be timed
+	 */
+	std::function<std::function<void()>(std::size_t n)> prepare;
+};
+
+auto executor() -> std::shared_ptr<DSS::executor_t>
+{
+	static std::unique_ptr<DSS::environment_t> env = nullptr;
+
+	if (env == nullptr)
+	{
+		env = std::make_unique<DSS::environment_t>();
+		env->init();
+	}
+
+	return env->spawn_executor();
+}
+
+auto repeat_lines(std::size_t n, const std::function<std::string(std::size_t)> &line) -> std::string
+{
+	std::string res;
+	for (std::size_t i = 0; i < n; i++)
+	{
+		res += line(i);
+		res += DSS::key::MULTILINE_DELIM;
+	}
+	return res;
+}
+
+auto paths() -> std::vector<path_t>
+{
+	return {
+		{"lines", 20000, 1.0,
+		 [](std::size_t n) {
+			 std::string script = repeat_lines(n, [](std::size_t) { return "out line"; });
+			 return std::function<void()>([script] { dss_utils::string_split(script, DSS::key::MULTILINE_DELIM); });
+		 }},
+		{"tokens", 20000, 1.0,
+		 [](std::size_t n) {
+			 std::string script = "let x";
+			 for (std::size_t i = 0; i < n; i++)
+			 {
+				 script += " token";
+			 }
+			 std::shared_ptr<DSS::executor_t> ex = executor();
+			 return std::function<void()>([ex, script] { ex->exec(script); });
+		 }},
+		{"replace", 20000, 1.0,
+		 [](std::size_t n) {
+			 std::string script = repeat_lines(n, [](std::size_t) { return "out $A"; });
+			 return std::function<void()>([script] {
+				 std::string copy = script;
+				 dss_utils::string_replace(copy, "$A", "$A $A");
+			 });
+		 }},
+		{"aliases", 1000, 1.0,
+		 [](std::size_t n) {
+			 std::string script = repeat_lines(2 * n, [n](std::size_t i) { return "alias_def A" + std::to_string(i % n) + " " + std::to_string(i); });
+			 std::shared_ptr<DSS::executor_t> ex = executor();
+			 return std::function<void()>([ex, script] { ex->exec(script); });
+		 }},
+		{"variables", 2000, 1.0,
+		 [](std::size_t n) {
+			 std::string script = repeat_lines(n, [](std::size_t i) { return "let v" + std::to_string(i) + " " + std::to_string(i); });
+			 script += repeat_lines(n, [](std::size_t i) { return "inc v" + std::to_string(i); });
+			 std::shared_ptr<DSS::executor_t> ex = executor();
+			 return std::function<void()>([ex, script] { ex->exec(script); });
+		 }},
+		{"commands", 5000, 1.0,
+		 [](std::size_t n) {
+			 std::string script = "let i 0\nrepeat " + std::to_string(n) + "\ninc i\nend\n";
+			 script += repeat_lines(n, [](std::size_t) { return "inc i"; });
+			 std::shared_ptr<DSS::executor_t> ex = executor();
+			 return std::function<void()>([ex, script] { ex->exec(script); });
+		 }},
+		{"executors", 2000, 1.1,
+		 [](std::size_t n) {
+			 return std::function<void()>([n] {
+				 DSS::environment_t env = DSS::environment_t();
+				 std::vector<DSS::run_id_t> ids = {};
+				 for (std::size_t i = 0; i < n; i++)
+				 {
+					 ids.push_back(env.spawn_executor()->get_id());
+				 }
+				 for (DSS::run_id_t id : ids)
+				 {
+					 env.executor_by_id(id);
+				 }
+			 });
+		 }},
+	};
+}
+
+/**
+ * @return The fastest of several runs, in seconds
+ */
+auto measure(const path_t &path, std::size_t n) -> double
+{
+	double best = INFINITY;
+
+	for (int i = 0; i < 3; i++)
+	{
+		std::function<void()> work = path.prepare(n);
+
+		auto start = std::chrono::steady_clock::now();
+		work();
+		best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+	}
+
+	return best;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+	double scale = 1.0;
+	double slack = 0.4;
+	std::string only = "";
+
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		std::string key = argv[i];
+		std::string value = argv[i + 1];
+
+		if (key == "--scale")
+			scale = std::stod(value);
+		else if (key == "--slack")
+			slack = std::stod(value);
+		else if (key == "--only")
+			only = value;
+		else
+		{
+			std::cerr << "unknown option " << key << std::endl;
+			return 2;
+		}
+	}
+
+	int failures = 0;
+
+	for (const auto &path : paths())
+	{
+		if (only.empty() == false && path.name != only)
+		{
+			continue;
+		}
+
+		std::size_t n = std::max<std::size_t>(std::size_t(double(path.n) * scale), 1);
+		std::vector<double> times = {};
+		for (std::size_t size = n; size <= 8 * n; size *= 2)
+		{
+			times.push_back(measure(path, size));
+		}
+
+		// Fitted over the whole range, as single doublings are noisy
+		double exponent = std::log2(times.back() / times.front()) / double(times.size() - 1);
+		bool ok = exponent <= path.exponent + slack;
+
+		std::cout << path.name << ": N=" << n;
+		for (double time : times)
+		{
+			std::cout << " " << time * 1000.0 << "ms";
+		}
+		std::cout << " exponent=" << exponent << " limit=" << path.exponent + slack << (ok == true ? " ok" : " FAILED") << std::endl;
+
+		if (ok == false)
+		{
+			failures++;
+		}
+	}
+
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,1130 @@
+/**
+ * Differential equivalence harness.
+ *
+ * Runs scripts through a reference engine and through alternative engines
+ * side by side. The reference is a frozen copy of the lexer, alias expansion
+ * and dispatch loop DSS had before they were optimised (see `legacy`), so it
+ * shares none of them with the engines under test; only the command handlers
+ * are common to both. Output and errors (as one
+ * ordered stream) and the final variables of every engine must be identical.
+ * Any mismatch is shrunk to a minimal script (removing lines, then tokens,
+ * then whitespace) before it is reported.
+ *
+ * Scripts are randomly generated, with edge cases (empty lines, repeated
+ * spaces, comments, aliases, unknown commands, bad arguments, unbalanced
+ * control flow), and optionally read from a corpus directory.
+ *
+ * Usage: DSSBenchDifferential [--engine all|ir|fork|stored|hibernate] [--seed 1] [--cases 1000]
+ *        [--lines 16] [--corpus <dir>]
+ *
+ * --engine  The alternative engine compared against the reference (all by default)
+ * --cases   Random scripts per engine
+ * --lines   Statements per random script (control flow blocks count as one)
+ * --corpus  Also runs every .dss file of the directory (paths are relative to the
+ *           working directory, as with `src`)
+ *
+ * New engines are added to `engines()`. Exits with status 1 on any mismatch.
+ */
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+#include "DSS.h"
+#include "dss_lang.h"
+#include "ir.h"
+
+namespace
+{
+
+struct options_t
+{
+	std::string engine = "all";
+	std::uint64_t seed = 1;
+	std::size_t cases = 1000;
+	std::size_t lines = 16;
+	std::string corpus = "";
+};
+
+/**
+ * Everything observable about a run
+ */
+struct observation_t
+{
+	/**
+	 * Output and errors, in the order they were written
+	 */
+	std::string stream = "";
+	std::string vars = "";
+
+	bool operator==(const observation_t &) const = default;
+};
+
+/**
+ * Runs a script from a fresh state, and observes the run
+ */
+typedef std::function<observation_t(const std::string &)> engine_t;
+
+auto describe(const std::any &element) -> std::string
+{
+	if (const std::string *value = std::any_cast<std::string>(&element))
+	{
+		return "\"" + *value + "\"";
+	}
+	if (const std::int64_t *value = std::any_cast<std::int64_t>(&element))
+	{
+		return std::to_string(*value);
+	}
+	if (const lang::alias_t *value = std::any_cast<lang::alias_t>(&element))
+	{
+		return "alias(" + value->id + ", " + value->value + ")";
+	}
+	return std::string("<") + element.type().name() + ">";
+}
+
+/**
+ * @return The variables of an executor, sorted by id
+ */
+auto dump_vars(DSS::executor_t &executor) -> std::string
+{
+	std::vector<std::string> lines = {};
+
+	for (const auto &var : executor.get_vars().all())
+	{
+		std::string line = var->get_id();
+		line += " =";
+		for (const auto &element : var->get_data())
+		{
+			line += ' ';
+			line += describe(element);
+		}
+		lines.push_back(line);
+	}
+
+	std::sort(lines.begin(), lines.end());
+
+	std::string res;
+	for (const auto &line : lines)
+	{
+		res += line;
+		res += '\n';
+	}
+	return res;
+}
+
+/**
+ * Captures `std::cout` and the logger into one stream for the duration
+ * of a run. The logger is not started, so errors are written as they are
+ * pushed, in order with the output.
+ */
+class capture_t
+{
+public:
+	capture_t(observation_t &observation) : m_observation(observation)
+	{
+		m_previous = std::cout.rdbuf(m_output.rdbuf());
+		DSS::logger().set_writer([this](const std::string &text) { m_output << text; });
+	}
+
+	~capture_t()
+	{
+		std::cout.rdbuf(m_previous);
+		DSS::logger().set_writer(nullptr);
+		m_observation.stream = m_output.str();
+	}
+
+private:
+	observation_t &m_observation;
+	std::ostringstream m_output;
+	std::streambuf *m_previous = nullptr;
+};
+
+/**
+ * Runs a script on the main executor of a fresh environment
+ *
+ * @param prepare Turns the main executor into the one which runs the script
+ * @param finish Called once the script ran, before the variables are observed
+ */
+auto run_fresh(const std::string &script, std::function<std::shared_ptr<DSS::executor_t>(std::shared_ptr<DSS::executor_t>)> prepare,
+	std::function<void(DSS::executor_t &)> finish) -> observation_t
+{
+	// Environments cannot be moved, and are not reused so that runs cannot affect each other
+	std::unique_ptr<DSS::environment_t> env = std::make_unique<DSS::environment_t>();
+	observation_t res = {};
+
+	{
+		capture_t capture(res);
+
+		env->init();
+		std::shared_ptr<DSS::executor_t> executor = prepare(env->main_executor());
+		executor->exec(script);
+		finish(*executor);
+		res.vars = dump_vars(*executor);
+	}
+
+	return res;
+}
+
+/**
+ * The reference engine: the lexer, alias expansion, and task and dispatch
+ * loop of DSS before the IR, frozen. Every statement is split when it runs,
+ * and every loaded command attempts it. Control flow, which the IR
+ * introduced, is interpreted by walking the statements.
+ *
+ * Do not change this to follow the runtime. It is the behaviour which the
+ * runtime must keep, and only changes when the language does.
+ */
+namespace legacy
+{
+
+/**
+ * A task and the tasks it queued. Reached through `t_run`, as
+ * commands are plain functions.
+ */
+struct run_t
+{
+	std::string script = "";
+	std::vector<std::string> queued = {};
+	std::vector<std::string> independent = {};
+};
+
+thread_local run_t *t_run = nullptr;
+
+/**
+ * `dss_utils::string_split` as it was: quadratic, as it erases the front
+ */
+auto string_split(std::string s, const std::string &delimiter) -> std::vector<std::string>
+{
+	std::vector<std::string> tokens;
+	std::size_t pos = 0;
+	std::string token;
+
+	while ((pos = s.find(delimiter)) != std::string::npos)
+	{
+		token = s.substr(0, pos);
+		tokens.push_back(token);
+		s.erase(0, (pos + delimiter.length()));
+	}
+	tokens.push_back(s);
+
+	return tokens;
+}
+
+/**
+ * `dss_utils::string_replace` as it was, except that it searches on from the
+ * end of a replacement rather than from the start. Rescanning from the start
+ * never terminates once a value contains its own dereference.
+ */
+void string_replace(std::string &s, const std::string &what, const std::string &with)
+{
+	std::size_t pos = 0;
+
+	while ((pos = s.find(what, pos)) != std::string::npos)
+	{
+		s.replace(pos, what.size(), with);
+		pos += with.size();
+	}
+}
+
+/**
+ * The alias preprocessor as it was: the whole script is replaced once per
+ * alias, longest id first. It sorted the variable in place, unstably; aliases
+ * of the same length now apply in the order they were defined.
+ */
+auto alias(DSS::executor_t *p_ex, DSS::func_args_t args) -> DSS::return_type_t
+{
+	(void)args;
+
+	std::shared_ptr<const DSS::var_t<std::any>> alias_var = p_ex->get_vars().get_var(lang::ALIAS_VAR);
+	if (alias_var == nullptr)
+	{
+		return 1;
+	}
+
+	std::vector<lang::alias_t> aliases = {};
+	for (const auto &element : alias_var->get_data())
+	{
+		aliases.push_back(std::any_cast<lang::alias_t>(element));
+	}
+	std::stable_sort(aliases.begin(), aliases.end(), [](const lang::alias_t &a, const lang::alias_t &b) { return a.id.length() > b.id.length(); });
+
+	for (const auto &alias : aliases)
+	{
+		string_replace(t_run->script, lang::ALIAS_DEREF + alias.id, alias.value);
+	}
+
+	return 0;
+}
+
+auto source(DSS::executor_t *p_ex, DSS::func_args_t args) -> DSS::return_type_t
+{
+	if (args.size() > 1 && args[1] != lang::func::SRC_INDEPENDENT)
+	{
+		return 3;
+	}
+
+	std::ifstream file(p_ex->resolve_path(args[0]), std::ios::binary);
+	if (file.is_open() == false)
+	{
+		return 2;
+	}
+
+	std::stringstream contents;
+	contents << file.rdbuf();
+	(args.size() > 1 ? t_run->independent : t_run->queued).push_back(contents.str());
+
+	return 0;
+}
+
+auto preprocessors(DSS::executor_t *executor) -> std::vector<DSS::command_t>
+{
+	return {
+		DSS::command_t(source, "src", "", 1, 2, executor),
+		DSS::command_t(lang::func::alias_def, "alias_def", "", 2, -1, executor),
+		DSS::command_t(alias, "alias", "", -1, -1, executor),
+	};
+}
+
+auto commands(DSS::executor_t *executor) -> std::vector<DSS::command_t>
+{
+	return {
+		DSS::command_t(lang::func::out, "out", "", 1, -1, executor),
+		DSS::command_t(lang::func::curdir, "cd", "", 1, 1, executor),
+		DSS::command_t(lang::func::ls, "ls", "", 0, 4, executor),
+		DSS::command_t(lang::func::let, "let", "", 2, -1, executor),
+		DSS::command_t(lang::func::inc, "inc", "", 1, 2, executor),
+		DSS::command_t(lang::func::cpu, "cpu", "", 0, 0, executor),
+		DSS::command_t(lang::func::incidents, "incidents", "", 0, 0, executor),
+	};
+}
+
+void find_and_push_error(const std::string &command, DSS::return_type_t code, int line)
+{
+	try
+	{
+		DSS::push_error(lang::ERR_KEY.at(command).at(code), line);
+	}
+	catch (std::out_of_range &_e)
+	{
+		DSS::push_error(DSS::err::UNKNOWN, line);
+	}
+}
+
+void dispatch(std::vector<DSS::command_t> &commands, const DSS::strvec_t &parsed, int line)
+{
+	DSS::delegate_return_t res = {};
+
+	for (auto command : commands)
+	{
+		DSS::delegate_return_t opt_res = command.attempt_parse_and_exec(parsed, line);
+
+		if (opt_res.size() == 0)
+		{
+			continue; // Failed to parse
+		}
+
+		res = opt_res;
+	}
+
+	if (res.size() == 0 || res[0] == 0)
+	{
+		return;
+	}
+
+	find_and_push_error(parsed[0], res[0], line);
+}
+
+void direct_exec(std::vector<DSS::command_t> &commands, const DSS::strvec_t &statements)
+{
+	int line = -1;
+
+	for (const auto &statement : statements)
+	{
+		line++;
+		DSS::strvec_t parsed = string_split(statement, DSS::key::TOKEN_DELIM);
+
+		if (parsed.size() > 0)
+		{
+			dispatch(commands, parsed, line);
+		}
+	}
+}
+
+auto is_cmp(const std::string &token) -> bool
+{
+	return token == "==" || token == "!=" || token == "<" || token == "<=" || token == ">" || token == ">=";
+}
+
+/**
+ * @return The condition `<lhs> <cmp> <rhs>`, or std::nullopt if an operand is undefined
+ */
+auto condition(DSS::vars_t &vars, const DSS::strvec_t &parsed) -> std::optional<bool>
+{
+	auto operand = [&vars](const std::string &token) -> std::optional<DSS::ir::value_t> {
+		DSS::ir::value_t literal = DSS::ir::parse_value(token);
+		if (std::holds_alternative<std::int64_t>(literal) == true)
+		{
+			return literal;
+		}
+		return DSS::ir::load_value(vars, token);
+	};
+
+	std::optional<DSS::ir::value_t> lhs = operand(parsed[1]);
+	std::optional<DSS::ir::value_t> rhs = operand(parsed[3]);
+	if (lhs.has_value() == false || rhs.has_value() == false)
+	{
+		return std::nullopt;
+	}
+
+	const std::string &cmp = parsed[2];
+	auto compare = [&cmp](const auto &a, const auto &b) {
+		return cmp == "==" ? a == b : cmp == "!=" ? a != b : cmp == "<" ? a < b : cmp == "<=" ? a <= b : cmp == ">" ? a > b : a >= b;
+	};
+
+	if (std::holds_alternative<std::int64_t>(lhs.value()) == true && std::holds_alternative<std::int64_t>(rhs.value()) == true)
+	{
+		return compare(std::get<std::int64_t>(lhs.value()), std::get<std::int64_t>(rhs.value()));
+	}
+
+	auto text = [](const DSS::ir::value_t &value) {
+		return std::holds_alternative<std::int64_t>(value) == true ? std::to_string(std::get<std::int64_t>(value)) : std::get<std::string>(value);
+	};
+	return compare(text(lhs.value()), text(rhs.value()));
+}
+
+/**
+ * The `else` (if any) and `end` of the block opened on each line
+ */
+struct block_t
+{
+	std::optional<std::size_t> otherwise = std::nullopt;
+	std::size_t end = 0;
+};
+
+/**
+ * Matches every block to its `end`, before anything runs
+ *
+ * @return false if the blocks are malformed. The error has been pushed.
+ */
+auto match_blocks(const std::vector<DSS::strvec_t> &parsed, std::map<std::size_t, block_t> &blocks) -> bool
+{
+	std::vector<std::pair<std::size_t, std::string>> open = {};
+
+	for (std::size_t line = 0; line < parsed.size(); line++)
+	{
+		if (parsed[line].size() == 0)
+		{
+			continue;
+		}
+
+		const std::string &keyword = parsed[line][0];
+
+		if (keyword == DSS::ir::key::IF || keyword == DSS::ir::key::WHILE)
+		{
+			if (parsed[line].size() != 4 || is_cmp(parsed[line][2]) == false)
+			{
+				DSS::push_error(DSS::ir::err::BAD_CONDITION, int(line));
+				return false;
+			}
+			open.emplace_back(line, keyword);
+		}
+		else if (keyword == DSS::ir::key::REPEAT)
+		{
+			if (parsed[line].size() != 2)
+			{
+				DSS::push_error(DSS::ir::err::BAD_COUNT, int(line));
+				return false;
+			}
+			open.emplace_back(line, keyword);
+		}
+		else if (keyword == DSS::ir::key::ELSE)
+		{
+			if (open.empty() == true || open.back().second != DSS::ir::key::IF)
+			{
+				DSS::push_error(DSS::ir::err::UNMATCHED_ELSE, int(line));
+				return false;
+			}
+			blocks[open.back().first].otherwise = line;
+			open.back().second = DSS::ir::key::ELSE;
+		}
+		else if (keyword == DSS::ir::key::END)
+		{
+			if (open.empty() == true)
+			{
+				DSS::push_error(DSS::ir::err::UNMATCHED_END, int(line));
+				return false;
+			}
+			blocks[open.back().first].end = line;
+			open.pop_back();
+		}
+	}
+
+	if (open.empty() == false)
+	{
+		DSS::push_error(DSS::ir::err::UNTERMINATED_BLOCK, int(open.back().first));
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Runs the statements in [first, last)
+ *
+ * @return false if the pass was aborted. The error has been pushed.
+ */
+auto run_block(DSS::executor_t &executor, std::vector<DSS::command_t> &commands, const std::vector<DSS::strvec_t> &parsed,
+	const std::map<std::size_t, block_t> &blocks, std::size_t first, std::size_t last) -> bool
+{
+	for (std::size_t line = first; line < last; line++)
+	{
+		if (parsed[line].size() == 0)
+		{
+			continue;
+		}
+
+		const std::string &keyword = parsed[line][0];
+
+		if (keyword == DSS::ir::key::IF)
+		{
+			const block_t &block = blocks.at(line);
+			std::optional<bool> res = condition(executor.get_vars(), parsed[line]);
+			if (res.has_value() == false)
+			{
+				DSS::push_error(DSS::ir::err::UNDEFINED_VAR, int(line));
+				return false;
+			}
+
+			bool completed = true;
+			if (res.value() == true)
+			{
+				completed = run_block(executor, commands, parsed, blocks, line + 1, block.otherwise.value_or(block.end));
+			}
+			else if (block.otherwise.has_value() == true)
+			{
+				completed = run_block(executor, commands, parsed, blocks, block.otherwise.value() + 1, block.end);
+			}
+			if (completed == false)
+			{
+				return false;
+			}
+			line = block.end;
+		}
+		else if (keyword == DSS::ir::key::WHILE)
+		{
+			const block_t &block = blocks.at(line);
+			while (true)
+			{
+				std::optional<bool> res = condition(executor.get_vars(), parsed[line]);
+				if (res.has_value() == false)
+				{
+					DSS::push_error(DSS::ir::err::UNDEFINED_VAR, int(line));
+					return false;
+				}
+				if (res.value() == false)
+				{
+					break;
+				}
+				if (run_block(executor, commands, parsed, blocks, line + 1, block.end) == false)
+				{
+					return false;
+				}
+			}
+			line = block.end;
+		}
+		else if (keyword == DSS::ir::key::REPEAT)
+		{
+			const block_t &block = blocks.at(line);
+			DSS::ir::value_t count = DSS::ir::parse_value(parsed[line][1]);
+			if (std::holds_alternative<std::int64_t>(count) == false)
+			{
+				std::optional<DSS::ir::value_t> loaded = DSS::ir::load_value(executor.get_vars(), parsed[line][1]);
+				if (loaded.has_value() == false || std::holds_alternative<std::int64_t>(loaded.value()) == false)
+				{
+					DSS::push_error(DSS::ir::err::BAD_COUNT, int(line));
+					return false;
+				}
+				count = loaded.value();
+			}
+
+			for (std::int64_t i = std::get<std::int64_t>(count); i > 0; i--)
+			{
+				if (run_block(executor, commands, parsed, blocks, line + 1, block.end) == false)
+				{
+					return false;
+				}
+			}
+			line = block.end;
+		}
+		else
+		{
+			dispatch(commands, parsed[line], int(line));
+		}
+	}
+
+	return true;
+}
+
+void exec_task(DSS::executor_t &executor, run_t &run)
+{
+	std::vector<DSS::command_t> loaded = preprocessors(&executor);
+	direct_exec(loaded, string_split(run.script, DSS::key::MULTILINE_DELIM));
+
+	DSS::strvec_t automatic = {};
+	for (const auto &element : executor.get_vars().get_or_add_var(DSS::AUTO_PREPROCESSOR_VAR)->get_data())
+	{
+		automatic.push_back(std::any_cast<std::string>(element));
+	}
+	direct_exec(loaded, automatic);
+
+	// Update after the preprocessors are finished
+	std::vector<DSS::strvec_t> parsed = {};
+	for (const auto &statement : string_split(run.script, DSS::key::MULTILINE_DELIM))
+	{
+		parsed.push_back(string_split(statement, DSS::key::TOKEN_DELIM));
+	}
+
+	loaded = commands(&executor);
+	std::map<std::size_t, block_t> blocks = {};
+	if (match_blocks(parsed, blocks) == true)
+	{
+		run_block(executor, loaded, parsed, blocks, 0, parsed.size());
+	}
+}
+
+/**
+ * Runs a script, then the scripts it queued. Independent scripts run
+ * one after another, in the order they were queued.
+ */
+void exec(DSS::executor_t &executor, std::string script)
+{
+	run_t *outer = t_run;
+	std::vector<std::string> tasks = {std::move(script)};
+
+	while (tasks.empty() == false)
+	{
+		run_t run = {};
+		t_run = &run;
+
+		std::vector<std::string> queued = {};
+		std::vector<std::string> independent = {};
+		for (auto &task : tasks)
+		{
+			run.script = std::move(task);
+			exec_task(executor, run);
+		}
+		queued.swap(run.queued);
+		independent.swap(run.independent);
+
+		for (auto &task : independent)
+		{
+			exec(executor, std::move(task));
+		}
+		tasks = std::move(queued);
+	}
+
+	t_run = outer;
+}
+
+} // namespace legacy
+
+auto reference(const std::string &script) -> observation_t
+{
+	std::unique_ptr<DSS::environment_t> env = std::make_unique<DSS::environment_t>();
+	observation_t res = {};
+
+	{
+		capture_t capture(res);
+
+		env->init();
+		legacy::exec(*env->main_executor(), script);
+		res.vars = dump_vars(*env->main_executor());
+	}
+
+	return res;
+}
+
+/**
+ * @return Every alternative engine, by name
+ */
+auto engines() -> std::vector<std::pair<std::string, engine_t>>
+{
+	return {
+		// Statements are compiled and run by the IR interpreter
+		{"ir",
+			[](const std::string &script) {
+				return run_fresh(
+					script, [](std::shared_ptr<DSS::executor_t> executor) { return executor; }, [](DSS::executor_t &) {});
+			}},
+		// Scripts run on a fork, as independent tasks do
+		{"fork",
+			[](const std::string &script) {
+				return run_fresh(
+					script, [](std::shared_ptr<DSS::executor_t> executor) { return executor->fork(); }, [](DSS::executor_t &) {});
+			}},
+		// Scripts are interned, so statements come from the shared buffer
+		{"stored",
+			[](const std::string &script) {
+				std::unique_ptr<DSS::environment_t> env = std::make_unique<DSS::environment_t>();
+				std::shared_ptr<const DSS::script_buffer_t> buffer = env->get_script_store().intern(script);
+
+				observation_t res = {};
+				{
+					capture_t capture(res);
+
+					env->init();
+					env->main_executor()->exec(buffer);
+					res.vars = dump_vars(*env->main_executor());
+				}
+				return res;
+			}},
+		// Variables are observed after a hibernation round trip
+		{"hibernate",
+			[](const std::string &script) {
+				return run_fresh(
+					script, [](std::shared_ptr<DSS::executor_t> executor) { return executor; },
+					[](DSS::executor_t &executor) { executor.hibernate(); });
+			}},
+	};
+}
+
+/**
+ * SplitMix64, as in generate.cpp
+ */
+class rng_t
+{
+public:
+	rng_t(std::uint64_t seed = 1) { m_state = seed; }
+
+	auto next() -> std::uint64_t
+	{
+		std::uint64_t z = (m_state += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+
+	auto below(std::uint64_t bound) -> std::uint64_t { return bound == 0 ? 0 : next() % bound; }
+
+private:
+	std::uint64_t m_state;
+};
+
+/**
+ * Generates scripts which favour edge cases over realism
+ */
+class generator_t
+{
+public:
+	generator_t(std::uint64_t seed) { m_rng = rng_t(seed); }
+
+	auto script(std::size_t lines) -> std::string
+	{
+		std::vector<std::string> res = {};
+		m_loops = 0;
+
+		for (std::size_t i = 0; i < lines; i++)
+		{
+			statement(res, 0);
+		}
+
+		std::string text;
+		for (const auto &line : res)
+		{
+			text += line + DSS::key::MULTILINE_DELIM;
+		}
+		return text;
+	}
+
+private:
+	rng_t m_rng;
+	std::size_t m_loops = 0;
+
+	auto pick(const std::vector<std::string> &from) -> std::string { return from[m_rng.below(from.size())]; }
+
+	/**
+	 * Joins tokens with one or more spaces, sometimes with
+	 * leading or trailing spaces
+	 */
+	auto join(const std::vector<std::string> &tokens) -> std::string
+	{
+		std::string res = m_rng.below(8) == 0 ? " " : "";
+
+		for (std::size_t i = 0; i < tokens.size(); i++)
+		{
+			if (i > 0)
+			{
+				res += std::string(m_rng.below(6) == 0 ? 2 + m_rng.below(2) : 1, ' ');
+			}
+			res += tokens[i];
+		}
+
+		if (m_rng.below(8) == 0)
+		{
+			res += " ";
+		}
+		return res;
+	}
+
+	auto variable() -> std::string { return pick({"a", "b", "c", "n0", "n1", "s0", "missing"}); }
+
+	auto value() -> std::string
+	{
+		switch (m_rng.below(6))
+		{
+		case 0:
+			return dereference(pick({"A0", "A1", "A2", "nope"}));
+		case 1:
+			return std::to_string(std::int64_t(m_rng.below(200)) - 100);
+		case 2:
+			return variable();
+		case 3:
+			return pick({"x", "hello", "-", "0x10", "1e3", "$", "$$A0"});
+		default:
+			return numbered("w", m_rng.below(10));
+		}
+	}
+
+	static auto dereference(const std::string &id) -> std::string
+	{
+		std::string res = "$";
+		res += id;
+		return res;
+	}
+
+	static auto numbered(const std::string &prefix, std::uint64_t number) -> std::string
+	{
+		std::string res = prefix;
+		res += std::to_string(number);
+		return res;
+	}
+
+	auto values(std::size_t most) -> std::vector<std::string>
+	{
+		std::vector<std::string> res = {};
+		std::size_t count = m_rng.below(most + 1);
+		for (std::size_t i = 0; i < count; i++)
+		{
+			res.push_back(value());
+		}
+		return res;
+	}
+
+	void statement(std::vector<std::string> &res, std::size_t depth)
+	{
+		std::vector<std::string> tokens = {};
+
+		switch (m_rng.below(depth == 0 ? 16 : 12))
+		{
+		case 0:
+			res.push_back("");
+			return;
+		case 1:
+			res.push_back(pick({"// comment", "//", "   ", "unknown_command x", "let", "inc", "alias_def A0", "end", "else"}));
+			return;
+		case 2:
+		case 3:
+			tokens = {"let", variable()};
+			break;
+		case 4:
+		case 5:
+			tokens = {"inc", variable()};
+			if (m_rng.below(2) == 0)
+			{
+				tokens.push_back(value());
+			}
+			break;
+		case 6:
+		case 7:
+			tokens = {"alias_def", pick({"A0", "A1", "A2"})};
+			break;
+		case 8:
+		case 9:
+		case 10:
+		case 11:
+			tokens = {"out"};
+			break;
+		case 12:
+			res.push_back(join({"if", variable(), pick({"==", "!=", "<", "<=", ">", ">=", "~"}), value()}));
+			block(res, depth);
+			if (m_rng.below(2) == 0)
+			{
+				res.push_back("else");
+				block(res, depth);
+			}
+			if (m_rng.below(10) != 0)
+			{
+				res.push_back("end");
+			}
+			return;
+		case 13:
+		{
+			std::string counter = numbered("w", m_loops++);
+			res.push_back("let " + counter + " 0");
+			res.push_back(join({"while", counter, "<", std::to_string(m_rng.below(4))}));
+			block(res, depth);
+			res.push_back("inc " + counter);
+			res.push_back("end");
+			return;
+		}
+		case 14:
+			res.push_back(join({"repeat", pick({"0", "1", "3", "-1", "n0", "x"})}));
+			block(res, depth);
+			res.push_back("end");
+			return;
+		default:
+			tokens = {"let", variable()};
+			break;
+		}
+
+		for (const auto &token : values(4))
+		{
+			tokens.push_back(token);
+		}
+		res.push_back(join(tokens));
+	}
+
+	void block(std::vector<std::string> &res, std::size_t depth)
+	{
+		std::size_t size = m_rng.below(3) + 1;
+		for (std::size_t i = 0; i < size; i++)
+		{
+			statement(res, depth + 1);
+		}
+	}
+};
+
+auto mismatch(const engine_t &engine, const std::string &script) -> bool { return reference(script) != engine(script); }
+
+auto split_lines(const std::string &script) -> DSS::strvec_t
+{
+	DSS::strvec_t res = dss_utils::string_split(script, DSS::key::MULTILINE_DELIM);
+	if (res.empty() == false && res.back().empty() == true)
+	{
+		res.pop_back();
+	}
+	return res;
+}
+
+auto join_lines(const DSS::strvec_t &lines) -> std::string
+{
+	std::string res;
+	for (const auto &line : lines)
+	{
+		res += line + DSS::key::MULTILINE_DELIM;
+	}
+	return res;
+}
+
+auto join_tokens(const DSS::strvec_t &tokens) -> std::string
+{
+	std::string res;
+	for (std::size_t i = 0; i < tokens.size(); i++)
+	{
+		res += (i == 0 ? "" : DSS::key::TOKEN_DELIM) + tokens[i];
+	}
+	return res;
+}
+
+/**
+ * Shrinks a mismatching script while it still mismatches: first whole
+ * chunks of lines (ddmin), then single tokens, then repeated spaces.
+ */
+auto shrink(const engine_t &engine, const std::string &script) -> std::string
+{
+	DSS::strvec_t lines = split_lines(script);
+
+	for (std::size_t chunk = std::max<std::size_t>(lines.size() / 2, 1); chunk > 0; chunk /= 2)
+	{
+		for (std::size_t start = 0; start < lines.size();)
+		{
+			DSS::strvec_t candidate = lines;
+			candidate.erase(candidate.begin() + start, candidate.begin() + std::min(start + chunk, candidate.size()));
+
+			if (mismatch(engine, join_lines(candidate)) == true)
+			{
+				lines = candidate;
+				continue;
+			}
+			start += chunk;
+		}
+	}
+
+	for (std::size_t i = 0; i < lines.size(); i++)
+	{
+		DSS::strvec_t tokens = dss_utils::string_split(lines[i], DSS::key::TOKEN_DELIM);
+
+		for (std::size_t j = 0; j < tokens.size();)
+		{
+			DSS::strvec_t candidate_tokens = tokens;
+			candidate_tokens.erase(candidate_tokens.begin() + j);
+
+			DSS::strvec_t candidate = lines;
+			candidate[i] = join_tokens(candidate_tokens);
+
+			if (mismatch(engine, join_lines(candidate)) == true)
+			{
+				tokens = candidate_tokens;
+				lines = candidate;
+				continue;
+			}
+			j++;
+		}
+
+		// Repeated spaces appear as empty tokens
+		DSS::strvec_t compact = {};
+		std::copy_if(tokens.begin(), tokens.end(), std::back_inserter(compact), [](const std::string &token) { return token.empty() == false; });
+
+		DSS::strvec_t candidate = lines;
+		candidate[i] = join_tokens(compact);
+		if (candidate[i] != lines[i] && mismatch(engine, join_lines(candidate)) == true)
+		{
+			lines = candidate;
+		}
+	}
+
+	return join_lines(lines);
+}
+
+void print_block(const std::string &title, const std::string &text)
+{
+	std::cerr << "--- " << title << " ---\n" << text;
+	if (text.empty() == false && text.back() != '\n')
+	{
+		std::cerr << "\n";
+	}
+}
+
+void report(const std::string &name, const engine_t &engine, const std::string &origin, const std::string &script)
+{
+	std::string shrunk = shrink(engine, script);
+	observation_t expected = reference(shrunk);
+	observation_t actual = engine(shrunk);
+
+	std::cerr << "mismatch: engine " << name << ", " << origin << "\n";
+	print_block("script (shrunk)", shrunk);
+
+	if (expected.stream != actual.stream)
+	{
+		print_block("reference output and errors", expected.stream);
+		print_block(name + " output and errors", actual.stream);
+	}
+	if (expected.vars != actual.vars)
+	{
+		print_block("reference variables", expected.vars);
+		print_block(name + " variables", actual.vars);
+	}
+}
+
+auto corpus_scripts(const std::string &directory) -> std::vector<std::pair<std::string, std::string>>
+{
+	std::vector<std::pair<std::string, std::string>> res = {};
+	if (directory.empty() == true)
+	{
+		return res;
+	}
+
+	for (const auto &entry : std::filesystem::directory_iterator(directory))
+	{
+		if (entry.path().extension() != ".dss")
+		{
+			continue;
+		}
+
+		std::ifstream file(entry.path(), std::ios::binary);
+		std::stringstream contents;
+		contents << file.rdbuf();
+		res.emplace_back(entry.path().string(), contents.str());
+	}
+
+	std::sort(res.begin(), res.end());
+	return res;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+	options_t options = {};
+
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		std::string key = argv[i];
+		std::string value = argv[i + 1];
+
+		if (key == "--engine")
+			options.engine = value;
+		else if (key == "--seed")
+			options.seed = std::stoull(value);
+		else if (key == "--cases")
+			options.cases = std::stoul(value);
+		else if (key == "--lines")
+			options.lines = std::stoul(value);
+		else if (key == "--corpus")
+			options.corpus = value;
+		else
+		{
+			std::cerr << "unknown option " << key << std::endl;
+			return 1;
+		}
+	}
+
+	std::vector<std::pair<std::string, std::string>> corpus = {};
+	try
+	{
+		corpus = corpus_scripts(options.corpus);
+	}
+	catch (std::filesystem::filesystem_error &e)
+	{
+		std::cerr << "failed to read the corpus: " << e.what() << std::endl;
+		return 1;
+	}
+
+	std::size_t failures = 0;
+	std::size_t compared = 0;
+
+	for (const auto &[name, engine] : engines())
+	{
+		if (options.engine != "all" && options.engine != name)
+		{
+			continue;
+		}
+		compared++;
+
+		std::size_t mismatches = 0;
+		generator_t generator = generator_t(options.seed);
+
+		for (std::size_t i = 0; i < options.cases; i++)
+		{
+			std::string script = generator.script(options.lines);
+			if (mismatch(engine, script) == true)
+			{
+				report(name, engine, "random case " + std::to_string(i) + " (seed " + std::to_string(options.seed) + ")", script);
+				mismatches++;
+			}
+		}
+
+		for (const auto &[path, script] : corpus)
+		{
+			if (mismatch(engine, script) == true)
+			{
+				report(name, engine, path, script);
+				mismatches++;
+			}
+		}
+
+		std::cout << name << ": " << options.cases + corpus.size() << " scripts, " << mismatches << " mismatches" << std::endl;
+		failures += mismatches;
+	}
+
+	if (compared == 0)
+	{
+		std::cerr << "unknown engine " << options.engine << std::endl;
+		return 1;
+	}
+
+	return failures == 0 ? 0 : 1;
+}
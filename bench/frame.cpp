@@ -0,0 +1,120 @@
+/**
+ * Compression of the script transport.
+ *
+ * Frames every script (or, without any, a generated trajectory upload),
+ * and reports its size on the wire, and the throughput of encoding and
+ * of reading it back through a frame reader.
+ *
+ * Usage: DSSBenchFrame [--rounds 20] [--points 20000] [<script>...]
+ */
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "DSS.h"
+
+namespace
+{
+
+struct options_t
+{
+	int rounds = 20;
+	std::size_t points = 20000;
+	std::vector<std::string> scripts = {};
+};
+
+/**
+ * A waypoint per line, as uploaded to a robot ahead of a move
+ */
+auto trajectory(std::size_t points) -> std::string
+{
+	std::string res;
+	for (std::size_t i = 0; i < points; i++)
+	{
+		res += "let wp" + std::to_string(i) + " " + std::to_string(1000 + (i * 7) % 250) + DSS::key::MULTILINE_DELIM;
+		res += "out move wp" + std::to_string(i) + " speed 100 accel 50" + DSS::key::MULTILINE_DELIM;
+	}
+	return res;
+}
+
+/**
+ * @return Throughput of `work` over `bytes`, in MB/s, from the fastest round
+ */
+template <typename F>
+auto throughput(int rounds, std::size_t bytes, F work) -> double
+{
+	double best = 1e300;
+	for (int i = 0; i < rounds; i++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		work();
+		best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+	}
+	return double(bytes) / best / 1e6;
+}
+
+auto report(const std::string &name, const std::string &script, int rounds) -> bool
+{
+	std::string framed = DSS::frame::encode(DSS::frame_type_t::SCRIPT, script);
+
+	double encode = throughput(rounds, script.size(), [&] { DSS::frame::encode(DSS::frame_type_t::SCRIPT, script); });
+
+	bool ok = true;
+	double decode = throughput(rounds, script.size(), [&] {
+		DSS::frame_reader_t reader;
+		reader.feed(framed);
+		std::optional<DSS::frame_t> frame = reader.next();
+		ok = ok && frame.has_value() == true && frame->payload.size() == script.size();
+	});
+
+	std::cout << name << ": " << script.size() << " -> " << framed.size() << " bytes (" << double(framed.size()) * 100.0 / double(script.size() + 1)
+			  << "%), encode " << encode << " MB/s, decode " << decode << " MB/s" << (ok == true ? "" : " FAILED") << std::endl;
+	return ok;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+	options_t options;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string key = argv[i];
+
+		if (key == "--rounds" && i + 1 < argc)
+			options.rounds = std::stoi(argv[++i]);
+		else if (key == "--points" && i + 1 < argc)
+			options.points = std::stoul(argv[++i]);
+		else if (key.rfind("--", 0) == 0)
+		{
+			std::cerr << "unknown option " << key << std::endl;
+			return 1;
+		}
+		else
+			options.scripts.push_back(key);
+	}
+
+	bool ok = true;
+
+	if (options.scripts.empty() == true)
+	{
+		ok = report("trajectory", trajectory(options.points), options.rounds);
+	}
+
+	for (const std::string &path : options.scripts)
+	{
+		std::ifstream file(path);
+		if (file.is_open() == false)
+		{
+			std::cerr << "cannot open " << path << std::endl;
+			return 1;
+		}
+		std::stringstream content;
+		content << file.rdbuf();
+		ok = report(path, content.str(), options.rounds) && ok;
+	}
+
+	return ok == true ? 0 : 1;
+}
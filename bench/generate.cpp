@@ -0,0 +1,338 @@
+/**
+ * Synthetic workload generator.
+ *
+ * Writes a DSS workload of `main.dss`, which sources `src_1.dss`, which
+ * sources `src_2.dss`, and so on, `--src-depth` files deep. The output only
+ * depends on the parameters, so workloads generated on different machines
+ * (or by different releases) are identical.
+ *
+ * Usage: DSSBenchGenerate --out <dir> [--prefix <dir>] [--seed 1] [--lines 1000]
+ *        [--aliases 32] [--alias-density 0.25] [--vars 16] [--statement-length 4]
+ *        [--src-depth 1] [--mix let:4,inc:4,alias_def:1,out:0,if:1,while:1,repeat:1]
+ *
+ * --lines             Statements per file (control flow blocks count as one)
+ * --aliases           Aliases defined at the top of main.dss
+ * --alias-density     Fraction of `let` and `out` arguments which dereference an alias
+ * --vars              Integer variables (n0...) and string variables (s0...)
+ * --statement-length  Arguments of every `let` and `out`
+ * --src-depth         Files sourced in a chain after main.dss
+ * --mix               Relative weights of every kind of statement
+ * --prefix            Directory `src` paths are written relative to (--out by default)
+ */
+
+#include <filesystem>
+#include <iostream>
+
+#include "DSS.h"
+
+namespace
+{
+
+struct options_t
+{
+	std::string out = "";
+	std::string prefix = "";
+	std::uint64_t seed = 1;
+	std::size_t lines = 1000;
+	std::size_t aliases = 32;
+	double alias_density = 0.25;
+	std::size_t vars = 16;
+	std::size_t statement_length = 4;
+	std::size_t src_depth = 1;
+	std::vector<std::pair<std::string, std::uint64_t>> mix = {{"let", 4}, {"inc", 4}, {"alias_def", 1}, {"out", 0}, {"if", 1}, {"while", 1}, {"repeat", 1}};
+};
+
+/**
+ * SplitMix64. Unlike the standard distributions, its output is the
+ * same with every standard library.
+ */
+class rng_t
+{
+public:
+	rng_t(std::uint64_t seed = 1) { m_state = seed; }
+
+	auto next() -> std::uint64_t
+	{
+		std::uint64_t z = (m_state += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+
+	auto below(std::uint64_t bound) -> std::uint64_t { return bound == 0 ? 0 : next() % bound; }
+
+	auto chance(double p) -> bool { return double(next() >> 11) * 0x1.0p-53 < p; }
+
+private:
+	std::uint64_t m_state;
+};
+
+class generator_t
+{
+public:
+	generator_t(const options_t &options)
+	{
+		m_options = options;
+		m_rng = rng_t(options.seed);
+
+		for (const auto &[kind, weight] : options.mix)
+		{
+			m_total_weight += weight;
+		}
+	}
+
+	auto file(std::size_t level) -> std::string
+	{
+		std::string res;
+
+		if (level == 0)
+		{
+			for (std::size_t i = 0; i < m_options.aliases; i++)
+			{
+				std::string statement = "alias_def A";
+				statement += std::to_string(i);
+				statement += ' ';
+				statement += alias_value(i);
+				line(res, statement);
+			}
+			for (std::size_t i = 0; i < m_options.vars; i++)
+			{
+				line(res, "let n" + std::to_string(i) + " 0");
+				line(res, "let s" + std::to_string(i) + " empty");
+			}
+		}
+
+		for (std::size_t i = 0; i < m_options.lines; i++)
+		{
+			statement(res, pick(), 0);
+		}
+
+		if (level < m_options.src_depth)
+		{
+			line(res, "src " + m_options.prefix + "/src_" + std::to_string(level + 1) + ".dss");
+		}
+
+		return res;
+	}
+
+private:
+	options_t m_options;
+	rng_t m_rng;
+	std::uint64_t m_total_weight = 0;
+	std::size_t m_loops = 0;
+
+	static void line(std::string &res, const std::string &statement)
+	{
+		res += statement;
+		res += DSS::key::MULTILINE_DELIM;
+	}
+
+	auto alias_value(std::size_t index) -> std::string
+	{
+		// Some aliases name variables, the rest are plain values
+		if (index % 2 == 0 && m_options.vars > 0)
+		{
+			return string_var();
+		}
+
+		std::string res = "value_";
+		res += std::to_string(m_rng.below(1000));
+		return res;
+	}
+
+	auto pick() -> std::string
+	{
+		std::uint64_t roll = m_rng.below(m_total_weight);
+
+		for (const auto &[kind, weight] : m_options.mix)
+		{
+			if (roll < weight)
+			{
+				return kind;
+			}
+			roll -= weight;
+		}
+
+		return "let";
+	}
+
+	auto int_var() -> std::string { return variable('n'); }
+
+	auto string_var() -> std::string { return variable('s'); }
+
+	auto variable(char prefix) -> std::string
+	{
+		std::string res(1, prefix);
+		res += std::to_string(m_rng.below(std::max<std::size_t>(m_options.vars, 1)));
+		return res;
+	}
+
+	auto arguments() -> std::string
+	{
+		std::string res;
+
+		for (std::size_t i = 0; i < m_options.statement_length; i++)
+		{
+			res += " ";
+			if (m_options.aliases > 0 && m_rng.chance(m_options.alias_density) == true)
+			{
+				res += "$A" + std::to_string(m_rng.below(m_options.aliases));
+			}
+			else
+			{
+				res += "word" + std::to_string(m_rng.below(100));
+			}
+		}
+
+		return res;
+	}
+
+	/**
+	 * Control flow is nested at most one level deep, and every
+	 * loop terminates after a few iterations.
+	 */
+	void statement(std::string &res, const std::string &kind, std::size_t depth)
+	{
+		bool nested = depth > 0;
+
+		if (kind == "inc")
+		{
+			line(res, "inc " + int_var() + " " + std::to_string(m_rng.below(5) + 1));
+		}
+		else if (kind == "out")
+		{
+			line(res, "out" + arguments());
+		}
+		else if (kind == "alias_def")
+		{
+			std::size_t index = m_options.aliases > 0 ? m_rng.below(m_options.aliases) : 0;
+			line(res, "alias_def A" + std::to_string(index) + " " + alias_value(index));
+		}
+		else if (kind == "if" && nested == false)
+		{
+			line(res, "if " + int_var() + " < " + std::to_string(m_rng.below(100)));
+			block(res, depth);
+			line(res, "else");
+			block(res, depth);
+			line(res, "end");
+		}
+		else if (kind == "while" && nested == false)
+		{
+			std::string counter = "w";
+			counter += std::to_string(m_loops++);
+			line(res, "let " + counter + " 0");
+			line(res, "while " + counter + " < " + std::to_string(m_rng.below(4) + 1));
+			block(res, depth);
+			line(res, "inc " + counter);
+			line(res, "end");
+		}
+		else if (kind == "repeat" && nested == false)
+		{
+			line(res, "repeat " + std::to_string(m_rng.below(4) + 1));
+			block(res, depth);
+			line(res, "end");
+		}
+		else
+		{
+			// Arguments are drawn before the variable, as GCC evaluated them, so seeds keep their corpus
+			std::string values = arguments();
+			std::string statement = "let ";
+			statement += string_var();
+			statement += values;
+			line(res, statement);
+		}
+	}
+
+	void block(std::string &res, std::size_t depth)
+	{
+		std::size_t size = m_rng.below(3) + 1;
+		for (std::size_t i = 0; i < size; i++)
+		{
+			statement(res, pick(), depth + 1);
+		}
+	}
+};
+
+auto parse_mix(const std::string &mix) -> std::vector<std::pair<std::string, std::uint64_t>>
+{
+	std::vector<std::pair<std::string, std::uint64_t>> res = {};
+
+	for (const auto &entry : dss_utils::string_split(mix, ","))
+	{
+		DSS::strvec_t parts = dss_utils::string_split(entry, ":");
+		if (parts.size() != 2)
+		{
+			return {};
+		}
+		res.emplace_back(parts[0], std::stoull(parts[1]));
+	}
+
+	return res;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+	options_t options = {};
+
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		std::string key = argv[i];
+		std::string value = argv[i + 1];
+
+		if (key == "--out")
+			options.out = value;
+		else if (key == "--prefix")
+			options.prefix = value;
+		else if (key == "--seed")
+			options.seed = std::stoull(value);
+		else if (key == "--lines")
+			options.lines = std::stoul(value);
+		else if (key == "--aliases")
+			options.aliases = std::stoul(value);
+		else if (key == "--alias-density")
+			options.alias_density = std::stod(value);
+		else if (key == "--vars")
+			options.vars = std::stoul(value);
+		else if (key == "--statement-length")
+			options.statement_length = std::stoul(value);
+		else if (key == "--src-depth")
+			options.src_depth = std::stoul(value);
+		else if (key == "--mix")
+			options.mix = parse_mix(value);
+		else
+		{
+			std::cerr << "unknown option " << key << std::endl;
+			return 1;
+		}
+	}
+
+	if (options.out.empty() == true || options.mix.empty() == true)
+	{
+		std::cerr << "usage: DSSBenchGenerate --out <dir> [options], see bench/generate.cpp" << std::endl;
+		return 1;
+	}
+
+	if (options.prefix.empty() == true)
+	{
+		options.prefix = options.out;
+	}
+
+	std::filesystem::create_directories(options.out);
+	generator_t generator = generator_t(options);
+
+	for (std::size_t level = 0; level <= options.src_depth; level++)
+	{
+		std::string name = level == 0 ? "main.dss" : "src_" + std::to_string(level) + ".dss";
+		std::ofstream file(options.out + "/" + name, std::ios::binary | std::ios::trunc);
+		if (file.is_open() == false)
+		{
+			std::cerr << "failed to write " << name << std::endl;
+			return 1;
+		}
+		file << generator.file(level);
+	}
+
+	return 0;
+}
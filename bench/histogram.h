@@ -0,0 +1,121 @@
+/**
+ * A high-dynamic-range latency histogram for the benchmarks.
+ *
+ * Values are recorded into log-linear buckets: every power of two is
+ * split into `SUB_BUCKETS` linear buckets, so any recorded value is
+ * reproduced within 1 / SUB_BUCKETS of its magnitude, from nanoseconds
+ * to hours, in constant memory.
+ */
+
+#ifndef H_BENCH_HISTOGRAM
+#define H_BENCH_HISTOGRAM
+
+#include <array>
+#include <bit>
+#include <cstdint>
+
+namespace bench
+{
+
+class histogram_t
+{
+public:
+	static const std::uint32_t SUB_BUCKET_BITS = 7;
+	static const std::uint32_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+
+	void record(std::uint64_t value)
+	{
+		m_counts[index_of(value)]++;
+		m_total++;
+		m_sum += value;
+		m_max = value > m_max ? value : m_max;
+	}
+
+	void merge(const histogram_t &other)
+	{
+		for (std::size_t i = 0; i < m_counts.size(); i++)
+		{
+			m_counts[i] += other.m_counts[i];
+		}
+		m_total += other.m_total;
+		m_sum += other.m_sum;
+		m_max = other.m_max > m_max ? other.m_max : m_max;
+	}
+
+	/**
+	 * @param percentile Between 0 and 100
+	 *
+	 * @return The highest value equivalent to the value at `percentile`
+	 */
+	auto percentile(double percentile) const -> std::uint64_t
+	{
+		if (m_total == 0)
+		{
+			return 0;
+		}
+
+		std::uint64_t rank = std::uint64_t(percentile / 100.0 * double(m_total) + 0.5);
+		rank = rank == 0 ? 1 : rank;
+
+		std::uint64_t seen = 0;
+		for (std::size_t i = 0; i < m_counts.size(); i++)
+		{
+			seen += m_counts[i];
+			if (seen >= rank)
+			{
+				std::uint64_t res = highest_of(i);
+				return res < m_max ? res : m_max;
+			}
+		}
+
+		return m_max;
+	}
+
+	auto count() const -> std::uint64_t { return m_total; }
+	auto max() const -> std::uint64_t { return m_max; }
+	auto mean() const -> double { return m_total == 0 ? 0.0 : double(m_sum) / double(m_total); }
+
+private:
+	/**
+	 * Values below 2 * SUB_BUCKETS are exact; every following power
+	 * of two is split into SUB_BUCKETS buckets.
+	 */
+	static const std::size_t EXACT = 2 * SUB_BUCKETS;
+	static const std::size_t BUCKETS = EXACT + (64 - SUB_BUCKET_BITS - 1) * SUB_BUCKETS;
+
+	std::array<std::uint64_t, BUCKETS> m_counts = {};
+	std::uint64_t m_total = 0;
+	std::uint64_t m_sum = 0;
+	std::uint64_t m_max = 0;
+
+	static auto index_of(std::uint64_t value) -> std::size_t
+	{
+		if (value < EXACT)
+		{
+			return std::size_t(value);
+		}
+
+		// Keep the leading bit and SUB_BUCKET_BITS below it
+		std::uint32_t shift = std::uint32_t(std::bit_width(value)) - SUB_BUCKET_BITS - 1;
+		std::uint64_t sub = (value >> shift) - SUB_BUCKETS;
+
+		return EXACT + std::size_t(shift - 1) * SUB_BUCKETS + std::size_t(sub);
+	}
+
+	static auto highest_of(std::size_t index) -> std::uint64_t
+	{
+		if (index < EXACT)
+		{
+			return std::uint64_t(index);
+		}
+
+		std::uint32_t shift = std::uint32_t((index - EXACT) / SUB_BUCKETS) + 1;
+		std::uint64_t sub = (index - EXACT) % SUB_BUCKETS + SUB_BUCKETS;
+
+		return ((sub + 1) << shift) - 1;
+	}
+};
+
+} // namespace bench
+
+#endif // H_BENCH_HISTOGRAM
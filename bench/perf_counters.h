@@ -0,0 +1,155 @@
+/**
+ * Hardware performance counters for the benchmarks, through
+ * Linux `perf_event_open`.
+ *
+ * Counters are optional: where they are not permitted (see
+ * /proc/sys/kernel/perf_event_paranoid) or not supported, such as
+ * in most containers and virtual machines, `available()` is false
+ * and every reading is zero.
+ */
+
+#ifndef H_BENCH_PERF_COUNTERS
+#define H_BENCH_PERF_COUNTERS
+
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace bench
+{
+
+struct perf_sample_t
+{
+	std::uint64_t cycles = 0;
+	std::uint64_t instructions = 0;
+	std::uint64_t cache_misses = 0;
+	std::uint64_t branch_misses = 0;
+};
+
+class perf_counters_t
+{
+public:
+	/**
+	 * Opens the counters for the calling thread, and every thread
+	 * it creates afterwards (but not threads which already exist).
+	 */
+	perf_counters_t()
+	{
+		const std::array<std::uint64_t, COUNTERS> configs = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES,
+															 PERF_COUNT_HW_BRANCH_MISSES};
+
+		for (std::size_t i = 0; i < COUNTERS; i++)
+		{
+			perf_event_attr attr = {};
+			attr.size = sizeof(attr);
+			attr.type = PERF_TYPE_HARDWARE;
+			attr.config = configs[i];
+			attr.disabled = 1;
+			attr.inherit = 1;
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+			m_fds[i] = int(syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+			if (m_fds[i] < 0)
+			{
+				m_error = std::strerror(errno);
+				close_all();
+				return;
+			}
+		}
+	}
+
+	~perf_counters_t() { close_all(); }
+
+	perf_counters_t(const perf_counters_t &) = delete;
+	perf_counters_t &operator=(const perf_counters_t &) = delete;
+
+	auto available() const -> bool { return m_fds[0] >= 0; }
+
+	/**
+	 * @return Why the counters are unavailable
+	 */
+	auto error() const -> const std::string & { return m_error; }
+
+	/**
+	 * Resets and starts every counter
+	 */
+	void start()
+	{
+		for (int fd : m_fds)
+		{
+			if (fd >= 0)
+			{
+				ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+				ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+			}
+		}
+	}
+
+	/**
+	 * Stops every counter
+	 *
+	 * @return Counts since `start()`, scaled up if the kernel had to
+	 * multiplex the counters
+	 */
+	auto stop() -> perf_sample_t
+	{
+		std::array<std::uint64_t, COUNTERS> values = {};
+
+		for (std::size_t i = 0; i < COUNTERS; i++)
+		{
+			if (m_fds[i] < 0)
+			{
+				continue;
+			}
+
+			ioctl(m_fds[i], PERF_EVENT_IOC_DISABLE, 0);
+
+			// Value, time enabled, time running
+			std::uint64_t read_values[3] = {};
+			if (read(m_fds[i], read_values, sizeof(read_values)) != ssize_t(sizeof(read_values)) || read_values[2] == 0)
+			{
+				continue;
+			}
+
+			values[i] = std::uint64_t(double(read_values[0]) * double(read_values[1]) / double(read_values[2]));
+		}
+
+		perf_sample_t res = {};
+		res.cycles = values[0];
+		res.instructions = values[1];
+		res.cache_misses = values[2];
+		res.branch_misses = values[3];
+		return res;
+	}
+
+private:
+	static const std::size_t COUNTERS = 4;
+
+	std::array<int, COUNTERS> m_fds = {-1, -1, -1, -1};
+	std::string m_error = "";
+
+	void close_all()
+	{
+		for (int &fd : m_fds)
+		{
+			if (fd >= 0)
+			{
+				close(fd);
+				fd = -1;
+			}
+		}
+	}
+};
+
+} // namespace bench
+
+#endif // H_BENCH_PERF_COUNTERS
@@ -0,0 +1,162 @@
+/**
+ * Keystroke-to-prompt latency of the interactive CLI.
+ *
+ * Runs a CLI in a child process behind a pseudo-terminal, as a terminal
+ * or an SSH session would, then repeatedly types a line and measures the
+ * time until the next prompt is printed.
+ *
+ * Usage: DSSBenchPrompt [--lines 1000] [--command "out x"]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <iostream>
+#include <vector>
+
+#include <poll.h>
+#include <pty.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "DSS.h"
+
+namespace
+{
+
+struct options_t
+{
+	std::size_t lines = 1000;
+	std::string command = "out x";
+};
+
+/**
+ * Marks the end of every prompt
+ */
+const std::string PROMPT_MARK = ">>>";
+
+const int READ_TIMEOUT_MS = 5000;
+
+/**
+ * Reads the terminal until `count` more prompts were printed
+ */
+auto wait_for_prompts(int fd, std::string &seen, std::size_t count) -> bool
+{
+	while (count > 0)
+	{
+		std::size_t found = seen.find(PROMPT_MARK);
+		if (found != std::string::npos)
+		{
+			seen.erase(0, found + PROMPT_MARK.size());
+			count--;
+			continue;
+		}
+
+		pollfd pfd = {fd, POLLIN, 0};
+		if (poll(&pfd, 1, READ_TIMEOUT_MS) <= 0)
+		{
+			return false;
+		}
+
+		char chunk[4096];
+		ssize_t res = read(fd, chunk, sizeof(chunk));
+		if (res <= 0)
+		{
+			return false;
+		}
+
+		// Only the end of the output can hold a partial mark
+		seen.erase(0, seen.size() > PROMPT_MARK.size() ? seen.size() - PROMPT_MARK.size() : 0);
+		seen.append(chunk, std::size_t(res));
+	}
+	return true;
+}
+
+auto write_all(int fd, const std::string &data) -> bool
+{
+	std::size_t written = 0;
+	while (written < data.size())
+	{
+		ssize_t res = write(fd, data.data() + written, data.size() - written);
+		if (res <= 0)
+		{
+			return false;
+		}
+		written += std::size_t(res);
+	}
+	return true;
+}
+
+auto percentile(const std::vector<double> &sorted, double p) -> double { return sorted[std::min(sorted.size() - 1, std::size_t(p * double(sorted.size())))]; }
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+	options_t options;
+
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		std::string key = argv[i];
+		std::string value = argv[i + 1];
+
+		if (key == "--lines")
+			options.lines = std::stoul(value);
+		else if (key == "--command")
+			options.command = value;
+		else
+		{
+			std::cerr << "unknown option " << key << std::endl;
+			return 1;
+		}
+	}
+
+	int master = -1;
+	pid_t child = forkpty(&master, nullptr, nullptr, nullptr);
+	if (child < 0)
+	{
+		std::cerr << "cannot open a pseudo-terminal" << std::endl;
+		return 1;
+	}
+
+	if (child == 0)
+	{
+		DSS::environment_t env = DSS::environment_t();
+		env.init();
+
+		DSS::cli_t cli = DSS::cli_t(env.main_executor());
+		cli.init();
+		_exit(0);
+	}
+
+	std::string seen = "";
+	bool ok = wait_for_prompts(master, seen, 1);
+
+	std::vector<double> latencies = {};
+	latencies.reserve(options.lines);
+	for (std::size_t i = 0; i < options.lines && ok == true; i++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		ok = write_all(master, options.command + "\n") && wait_for_prompts(master, seen, 1);
+		latencies.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+	}
+
+	if (write_all(master, "exit\n") == false || ok == false)
+	{
+		kill(child, SIGKILL);
+	}
+	waitpid(child, nullptr, 0);
+	close(master);
+
+	if (ok == false || latencies.empty() == true)
+	{
+		std::cerr << "the CLI stopped answering" << std::endl;
+		return 1;
+	}
+
+	std::sort(latencies.begin(), latencies.end());
+	std::cout << latencies.size() << " lines of \"" << options.command << "\": p50 " << percentile(latencies, 0.5) << "us, p99 " << percentile(latencies, 0.99)
+			  << "us, max " << latencies.back() << "us" << std::endl;
+
+	return 0;
+}
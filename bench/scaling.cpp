@@ -0,0 +1,318 @@
+/**
+ * Thread-scaling and tail-latency benchmark.
+ *
+ * Drives `--executors` executors from `--producers` producer threads,
+ * through the environment scheduler, for every worker count of the
+ * `--workers` sweep. Each producer keeps `--outstanding` tasks in flight
+ * and records the latency (submission to completion) of every task.
+ *
+ * With `--counters on`, hardware counters (cycles, instructions, cache
+ * and branch misses) are reported per dispatched statement, if the
+ * kernel permits reading them.
+ *
+ * Usage: DSSBenchScaling [--workers 1,2,4,8] [--executors 8] [--producers 4]
+ *        [--tasks 2000] [--outstanding 4] [--mix alias|loop|control|mixed]
+ *        [--script <path>] [--format csv|json] [--counters on|off]
+ */
+
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#include "DSS.h"
+#include "histogram.h"
+#include "perf_counters.h"
+
+namespace
+{
+
+struct options_t
+{
+	std::vector<std::size_t> workers = {1, 2, 4, 8};
+	std::size_t executors = 8;
+	std::size_t producers = 4;
+	std::size_t tasks = 2000;
+	std::size_t outstanding = 4;
+	std::string mix = "mixed";
+	std::string script = "";
+	std::string format = "csv";
+	bool counters = false;
+};
+
+struct result_t
+{
+	std::size_t workers = 0;
+	double seconds = 0.0;
+	bench::histogram_t latency = {};
+
+	/**
+	 * Statements dispatched by every executor
+	 */
+	std::uint64_t statements = 0;
+
+	std::optional<bench::perf_sample_t> counters = std::nullopt;
+};
+
+/**
+ * Scripts of every mix. None of them write to stdout.
+ */
+auto mix_scripts(const options_t &options) -> std::vector<std::string>
+{
+	const std::string alias = "alias_def TARGET 42\nalias_def AXIS x\nlet position $TARGET\nlet axis $AXIS";
+	const std::string loop = "let i 0\nrepeat 200\ninc i\nend";
+	const std::string control = "let i 0\nwhile i < 50\nif i == 25\nlet half 1\nelse\nlet half 0\nend\ninc i 1\nend";
+
+	if (options.script.empty() == false)
+	{
+		std::string path = options.script;
+		std::optional<std::string> res = dss_utils::file_read(path);
+		if (res.has_value() == true)
+		{
+			return {res.value()};
+		}
+		std::cerr << "failed to read " << options.script << std::endl;
+		return {};
+	}
+
+	if (options.mix == "alias")
+		return {alias};
+	if (options.mix == "loop")
+		return {loop};
+	if (options.mix == "control")
+		return {control};
+
+	return {alias, loop, control};
+}
+
+auto run(const options_t &options, std::size_t workers, const std::vector<std::string> &scripts) -> result_t
+{
+	DSS::environment_t env = DSS::environment_t();
+	env.init();
+
+	std::vector<DSS::run_id_t> ids = {};
+	for (std::size_t i = 0; i < options.executors; i++)
+	{
+		ids.push_back(env.spawn_executor()->get_id());
+	}
+
+	// Counters follow threads created after they are opened, so open them before the workers and producers
+	std::unique_ptr<bench::perf_counters_t> counters = nullptr;
+	if (options.counters == true)
+	{
+		counters = std::make_unique<bench::perf_counters_t>();
+	}
+
+	env.start_workers(workers);
+
+	std::vector<bench::histogram_t> latencies(options.producers);
+	std::vector<std::thread> producers = {};
+
+	if (counters != nullptr)
+	{
+		counters->start();
+	}
+	auto start = std::chrono::steady_clock::now();
+
+	for (std::size_t p = 0; p < options.producers; p++)
+	{
+		producers.emplace_back([&, p]() {
+			typedef std::pair<std::chrono::steady_clock::time_point, std::future<DSS::return_type_t>> in_flight_t;
+			std::deque<in_flight_t> in_flight = {};
+
+			for (std::size_t t = 0; t < options.tasks; t++)
+			{
+				if (in_flight.size() >= options.outstanding)
+				{
+					in_flight.front().second.wait();
+					latencies[p].record(std::uint64_t((std::chrono::steady_clock::now() - in_flight.front().first).count()));
+					in_flight.pop_front();
+				}
+
+				DSS::run_id_t id = ids[(p + t) % ids.size()];
+				const std::string &script = scripts[t % scripts.size()];
+				in_flight.emplace_back(std::chrono::steady_clock::now(), env.submit(id, script));
+			}
+
+			while (in_flight.empty() == false)
+			{
+				in_flight.front().second.wait();
+				latencies[p].record(std::uint64_t((std::chrono::steady_clock::now() - in_flight.front().first).count()));
+				in_flight.pop_front();
+			}
+		});
+	}
+
+	for (auto &producer : producers)
+	{
+		producer.join();
+	}
+
+	result_t res = {};
+	res.workers = workers;
+	res.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	if (counters != nullptr && counters->available() == true)
+	{
+		res.counters = counters->stop();
+	}
+	else if (counters != nullptr)
+	{
+		std::cerr << "hardware counters unavailable: " << counters->error() << std::endl;
+	}
+
+	for (auto &latency : latencies)
+	{
+		res.latency.merge(latency);
+	}
+	for (DSS::run_id_t id : ids)
+	{
+		res.statements += env.executor_by_id(id)->get_cpu_usage().statements;
+	}
+
+	return res;
+}
+
+auto parse_list(const std::string &list) -> std::vector<std::size_t>
+{
+	std::vector<std::size_t> res = {};
+	for (auto &token : dss_utils::string_split(list, ","))
+	{
+		if (token.empty() == false)
+		{
+			res.push_back(std::stoul(token));
+		}
+	}
+	return res;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+	options_t options = {};
+
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		std::string key = argv[i];
+		std::string value = argv[i + 1];
+
+		if (key == "--workers")
+			options.workers = parse_list(value);
+		else if (key == "--executors")
+			options.executors = std::stoul(value);
+		else if (key == "--producers")
+			options.producers = std::stoul(value);
+		else if (key == "--tasks")
+			options.tasks = std::stoul(value);
+		else if (key == "--outstanding")
+			options.outstanding = std::max<std::size_t>(std::stoul(value), 1);
+		else if (key == "--mix")
+			options.mix = value;
+		else if (key == "--script")
+			options.script = value;
+		else if (key == "--format")
+			options.format = value;
+		else if (key == "--counters")
+			options.counters = value == "on";
+		else
+		{
+			std::cerr << "unknown option " << key << std::endl;
+			return 1;
+		}
+	}
+
+	std::vector<std::string> scripts = mix_scripts(options);
+	if (scripts.empty() == true || options.executors == 0)
+	{
+		return 1;
+	}
+
+	bool json = options.format == "json";
+	std::stringstream out;
+
+	if (json == true)
+	{
+		out << "[\n";
+	}
+	else
+	{
+		out << "workers,executors,producers,mix,tasks,statements,seconds,throughput,mean_us,p50_us,p99_us,p999_us,max_us";
+		if (options.counters == true)
+		{
+			out << ",cycles_per_stmt,instructions_per_stmt,ipc,cache_misses_per_stmt,branch_misses_per_stmt";
+		}
+		out << "\n";
+	}
+
+	for (std::size_t i = 0; i < options.workers.size(); i++)
+	{
+		result_t res = run(options, options.workers[i], scripts);
+
+		std::uint64_t total = res.latency.count();
+		auto us = [](double ns) { return ns / 1000.0; };
+		std::string mix = options.script.empty() == true ? options.mix : options.script;
+
+		// Per dispatched statement, or empty if the counters are unavailable
+		std::vector<std::pair<std::string, std::string>> per_statement = {};
+		if (options.counters == true)
+		{
+			std::vector<std::pair<std::string, double>> values = {};
+			if (res.counters.has_value() == true && res.statements > 0)
+			{
+				const bench::perf_sample_t &sample = res.counters.value();
+				double statements = double(res.statements);
+				values = {{"cycles_per_stmt", double(sample.cycles) / statements},
+						  {"instructions_per_stmt", double(sample.instructions) / statements},
+						  {"ipc", sample.cycles == 0 ? 0.0 : double(sample.instructions) / double(sample.cycles)},
+						  {"cache_misses_per_stmt", double(sample.cache_misses) / statements},
+						  {"branch_misses_per_stmt", double(sample.branch_misses) / statements}};
+			}
+			else
+			{
+				values = {{"cycles_per_stmt", NAN}, {"instructions_per_stmt", NAN}, {"ipc", NAN}, {"cache_misses_per_stmt", NAN}, {"branch_misses_per_stmt", NAN}};
+			}
+
+			for (const auto &[name, value] : values)
+			{
+				std::stringstream formatted;
+				formatted << value;
+				per_statement.emplace_back(name, std::isnan(value) == true ? (json == true ? "null" : "") : formatted.str());
+			}
+		}
+
+		if (json == true)
+		{
+			out << "  {\"workers\": " << res.workers << ", \"executors\": " << options.executors << ", \"producers\": " << options.producers << ", \"mix\": \""
+				<< mix << "\", \"tasks\": " << total << ", \"statements\": " << res.statements << ", \"seconds\": " << res.seconds
+				<< ", \"throughput\": " << double(total) / res.seconds << ", \"mean_us\": " << us(res.latency.mean())
+				<< ", \"p50_us\": " << us(double(res.latency.percentile(50.0))) << ", \"p99_us\": " << us(double(res.latency.percentile(99.0)))
+				<< ", \"p999_us\": " << us(double(res.latency.percentile(99.9))) << ", \"max_us\": " << us(double(res.latency.max()));
+			for (const auto &[name, value] : per_statement)
+			{
+				out << ", \"" << name << "\": " << value;
+			}
+			out << "}" << (i + 1 < options.workers.size() ? "," : "") << "\n";
+		}
+		else
+		{
+			out << res.workers << "," << options.executors << "," << options.producers << "," << mix << "," << total << "," << res.statements << ","
+				<< res.seconds << "," << double(total) / res.seconds << "," << us(res.latency.mean()) << "," << us(double(res.latency.percentile(50.0)))
+				<< "," << us(double(res.latency.percentile(99.0))) << "," << us(double(res.latency.percentile(99.9))) << ","
+				<< us(double(res.latency.max()));
+			for (const auto &[name, value] : per_statement)
+			{
+				out << "," << value;
+			}
+			out << "\n";
+		}
+	}
+
+	if (json == true)
+	{
+		out << "]\n";
+	}
+
+	std::cout << out.str();
+
+	return 0;
+}
@@ -0,0 +1,84 @@
+/**
+ * Memory-per-session benchmark.
+ *
+ * Spawns many mostly idle executors (one per client session), then
+ * compares heap usage before and after hibernating them, and measures
+ * how long rehydration takes.
+ *
+ * Usage: DSSBenchSessions [sessions]
+ */
+
+#include <iostream>
+#include <malloc.h>
+
+#include "DSS.h"
+
+namespace
+{
+
+auto heap_in_use() -> std::size_t { return mallinfo2().uordblks; }
+
+auto session_script(std::size_t index) -> std::string
+{
+	return "alias_def USER operator_" + std::to_string(index) + "\nalias_def ROLE observer\nlet counter " + std::to_string(index) + "\nlet mode idle";
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+	std::size_t sessions = 100000;
+	if (argc > 1)
+	{
+		sessions = std::stoul(argv[1]);
+	}
+
+	DSS::environment_t env = DSS::environment_t();
+	env.init();
+
+	std::vector<std::shared_ptr<DSS::executor_t>> executors = {};
+	executors.reserve(sessions);
+
+	std::size_t baseline = heap_in_use();
+
+	for (std::size_t i = 0; i < sessions; i++)
+	{
+		std::shared_ptr<DSS::executor_t> executor = env.spawn_executor();
+		executor->exec(session_script(i));
+		executors.push_back(executor);
+	}
+
+	std::size_t active = heap_in_use() - baseline;
+
+	auto start = std::chrono::steady_clock::now();
+	std::size_t hibernated = 0;
+	for (auto &executor : executors)
+	{
+		if (executor->hibernate() == true)
+		{
+			hibernated++;
+		}
+	}
+	auto hibernate_time = std::chrono::steady_clock::now() - start;
+
+	std::size_t idle = heap_in_use() - baseline;
+
+	start = std::chrono::steady_clock::now();
+	for (auto &executor : executors)
+	{
+		executor->get_vars();
+	}
+	auto rehydrate_time = std::chrono::steady_clock::now() - start;
+
+	auto per = [sessions](std::size_t bytes) { return double(bytes) / double(sessions); };
+	auto ns_per = [sessions](auto time) { return double(std::chrono::duration_cast<std::chrono::nanoseconds>(time).count()) / double(sessions); };
+
+	std::cout << "sessions:             " << sessions << "\n";
+	std::cout << "hibernated:           " << hibernated << "\n";
+	std::cout << "bytes/session active: " << per(active) << "\n";
+	std::cout << "bytes/session idle:   " << per(idle) << "\n";
+	std::cout << "ns/session hibernate: " << ns_per(hibernate_time) << "\n";
+	std::cout << "ns/session rehydrate: " << ns_per(rehydrate_time) << "\n";
+
+	return 0;
+}
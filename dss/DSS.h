@@ -13,5 +13,18 @@
 #define H_DSS
 
 #include "cli.h"
+#include "scheduler.h"
+#include "work_pool.h"
+#include "process_pool.h"
+#include "snapshot.h"
+#include "journal.h"
+#include "watchdog.h"
+#include "log.h"
+#include "metrics.h"
+#include "simulation.h"
+#include "script_store.h"
+#include "frame.h"
+#include "memory.h"
+#include "listing.h"
 
 #endif // H_DSS
\ No newline at end of file
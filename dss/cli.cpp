@@ -1,7 +1,39 @@
 #include "cli.h"
+#include "log.h"
+#include <cerrno>
 #include <filesystem>
 #include <iostream>
 
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace
+{
+
+/**
+ * A line of input, split into statements by the input thread
+ */
+class input_line_t : public DSS::script_buffer_t
+{
+public:
+	input_line_t(std::string text)
+	{
+		m_text = std::move(text);
+		m_statements = dss_utils::string_split(m_text, DSS::key::MULTILINE_DELIM);
+	}
+
+	auto view() const -> std::string_view override { return m_text; }
+
+	auto statements() const -> const DSS::strvec_t * override { return &m_statements; }
+
+private:
+	std::string m_text;
+	DSS::strvec_t m_statements;
+};
+
+} // namespace
+
 void DSS::cli_t::init()
 {
 	console_clear();
@@ -14,29 +46,171 @@ void DSS::cli_t::execute(std::string what)
 	{
 		return;
 	}
-	m_bound_executor->exec(what);
+	m_bound_executor->exec(std::move(what));
 }
 
 void DSS::cli_t::input_loop()
 {
+	if (m_bound_executor == nullptr)
+	{
+		return;
+	}
+
 	m_bound_executor->exec("out [cli] DSS Version $__VERSION__");
+	start_input();
 
 	while (m_alive == true)
 	{
-		std::cout << "\033[34m" << std::filesystem::current_path().string() << "\033[0m \033[35m" << m_name << "\033[0m \033[1m \033[32m>>>\033[0m ";
-		std::string retrieved;
-		getline(std::cin, retrieved);
+		DSS::logger().flush(); // Errors of the previous input come before the prompt
+		refresh_prompt();
+		std::cout << m_prompt << std::flush;
 
-		if (retrieved == "exit")
+		std::shared_ptr<const DSS::script_buffer_t> line = next_line();
+		if (line == nullptr)
+		{
+			std::cout << std::endl; // End of input, such as Ctrl+D
+			m_alive = false;
+		}
+		else if (line->view() == "exit")
 		{
 			console_clear();
 			m_alive = false;
 		}
-		else if (retrieved == "clear")
+		else if (line->view() == "clear")
 		{
 			console_clear();
 		}
+		else
+		{
+			m_bound_executor->exec(std::move(line));
+		}
+	}
+
+	stop_input();
+}
+
+void DSS::cli_t::refresh_prompt()
+{
+	const std::string &directory = m_bound_executor->get_directory();
+	if (m_prompt.empty() == false && directory == m_prompt_directory)
+	{
+		return;
+	}
+	m_prompt_directory = directory;
+
+	std::error_code error;
+	std::string shown = directory.empty() == true ? std::filesystem::current_path(error).string() : directory;
+	m_prompt = "\033[34m" + shown + "\033[0m \033[35m" + m_name + "\033[0m \033[1m \033[32m>>>\033[0m ";
+}
+
+void DSS::cli_t::start_input()
+{
+	if (m_input_thread.joinable() == true)
+	{
+		return;
+	}
+
+	m_wake_fd = eventfd(0, EFD_CLOEXEC);
+	m_input_done = false;
+	m_input_thread = std::thread(&DSS::cli_t::read_input, this);
+}
+
+void DSS::cli_t::stop_input()
+{
+	if (m_input_thread.joinable() == false)
+	{
+		return;
+	}
+
+	std::uint64_t one = 1;
+	if (write(m_wake_fd, &one, sizeof(one)) < 0)
+	{
+		// The thread still stops at the end of the input
+	}
+	m_input_thread.join();
+
+	close(m_wake_fd);
+	m_wake_fd = -1;
+	m_lines.clear();
+}
+
+void DSS::cli_t::read_input()
+{
+	std::string pending = "";
+	char chunk[4096];
+
+	auto push = [this](std::string line) {
+		if (line.empty() == false && line.back() == '\r')
+		{
+			line.pop_back();
+		}
+		std::shared_ptr<const DSS::script_buffer_t> lexed = std::make_shared<input_line_t>(std::move(line));
+
+		std::lock_guard<std::mutex> lock(m_input_mutex);
+		m_lines.push_back(std::move(lexed));
+		m_input_ready.notify_one();
+	};
+
+	bool stopped = false;
+	while (true)
+	{
+		pollfd fds[2] = {{STDIN_FILENO, POLLIN, 0}, {m_wake_fd, POLLIN, 0}};
+		if (poll(fds, 2, -1) < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			break;
+		}
+		if (fds[1].revents != 0)
+		{
+			stopped = true;
+			break;
+		}
 
-		execute(retrieved);
+		ssize_t res = read(STDIN_FILENO, chunk, sizeof(chunk));
+		if (res < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (res <= 0)
+		{
+			break; // End of input
+		}
+
+		pending.append(chunk, std::size_t(res));
+
+		std::size_t start = 0;
+		for (std::size_t end = pending.find('\n'); end != std::string::npos; end = pending.find('\n', start))
+		{
+			push(pending.substr(start, end - start));
+			start = end + 1;
+		}
+		pending.erase(0, start);
+	}
+
+	if (stopped == false && pending.empty() == false)
+	{
+		push(std::move(pending)); // The last line may not end with a newline
+	}
+
+	std::lock_guard<std::mutex> lock(m_input_mutex);
+	m_input_done = true;
+	m_input_ready.notify_one();
+}
+
+auto DSS::cli_t::next_line() -> std::shared_ptr<const DSS::script_buffer_t>
+{
+	std::unique_lock<std::mutex> lock(m_input_mutex);
+	m_input_ready.wait(lock, [this] { return m_lines.empty() == false || m_input_done == true; });
+
+	if (m_lines.empty() == true)
+	{
+		return nullptr;
 	}
-}
\ No newline at end of file
+
+	std::shared_ptr<const DSS::script_buffer_t> res = std::move(m_lines.front());
+	m_lines.pop_front();
+	return res;
+}
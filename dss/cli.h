@@ -1,32 +1,78 @@
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <mutex>
 #include <string>
+#include <thread>
 
 #include "runtime.h"
 
 #ifndef CLI_H
 #define CLI_H
 
-inline void console_clear()
-{
-#if defined _WIN32
-	system("cls");
-#elif defined(__LINUX__) || defined(__gnu_linux__) || defined(__linux__)
-	system("clear");
-#elif defined(__APPLE__)
-	system("clear");
-#endif
-}
+/**
+ * Clears the terminal and its scrollback with escape sequences, rather than through a shell
+ */
+inline void console_clear() { std::cout << "\033[H\033[2J\033[3J" << std::flush; }
 
 namespace DSS
 {
 
 const std::string DEFAULT_CLI_NAME = "dss";
 
+/**
+ * Interactive console of an executor.
+ *
+ * Input is read on a dedicated thread, which splits the next line into
+ * statements while the current one executes, so a line typed ahead runs
+ * as soon as the prompt returns. The prompt is only rebuilt when the
+ * directory of the executor changes (`cd`).
+ */
 class cli_t
 {
 private:
-	std::shared_ptr<DSS::executor_t> m_bound_executor;
-	bool m_alive;
-	std::string m_name;
+	std::shared_ptr<DSS::executor_t> m_bound_executor = nullptr;
+	bool m_alive = false;
+	std::string m_name = DEFAULT_CLI_NAME;
+
+	/**
+	 * The rendered prompt, and the executor directory it shows
+	 */
+	std::string m_prompt = "";
+	std::string m_prompt_directory = "";
+
+	std::thread m_input_thread;
+
+	/**
+	 * Wakes the input thread to stop it
+	 */
+	int m_wake_fd = -1;
+
+	std::mutex m_input_mutex;
+	std::condition_variable m_input_ready;
+
+	/**
+	 * Lines read ahead by the input thread
+	 */
+	std::deque<std::shared_ptr<const script_buffer_t>> m_lines;
+
+	/**
+	 * Set once the input ended (or the input thread stopped)
+	 */
+	bool m_input_done = false;
+
+	void start_input();
+
+	void stop_input();
+
+	void read_input();
+
+	/**
+	 * @return The next line, or nullptr at the end of the input
+	 */
+	auto next_line() -> std::shared_ptr<const script_buffer_t>;
+
+	void refresh_prompt();
 
 public:
 	cli_t(std::shared_ptr<DSS::executor_t> bound_executor, std::string name)
@@ -53,13 +99,21 @@ public:
 		m_name = DEFAULT_CLI_NAME;
 	}
 
+	~cli_t() { stop_input(); }
+
+	cli_t(const cli_t &) = delete;
+	cli_t &operator=(const cli_t &) = delete;
+
 	void init();
 
 	void execute(std::string what);
 
+	/**
+	 * Runs lines from the standard input until `exit`, or the end of the input
+	 */
 	void input_loop();
 };
 
 } // namespace DSS
 
-#endif
\ No newline at end of file
+#endif
@@ -10,11 +10,16 @@
 #ifndef H_LANG
 #define H_LANG
 
-#include <iostream>
+#include <algorithm>
 #include <filesystem>
+#include <iostream>
+#include <unordered_map>
 
 #include "runtime.h"
 #include "dss_utils.h"
+#include "ir.h"
+#include "listing.h"
+#include "watchdog.h"
 
 namespace lang
 {
@@ -83,6 +88,20 @@ inline void use_alias(DSS::executor_t *p_ex)
 	auto_preproc_var->append_data(ALIAS_USE);
 }
 
+/**
+ * @return The id of an alias element, for keyed lookups
+ */
+inline auto alias_key(const std::any &element) -> std::optional<std::string>
+{
+	const alias_t *alias = std::any_cast<alias_t>(&element);
+	if (alias == nullptr)
+	{
+		return std::nullopt;
+	}
+
+	return alias->id;
+}
+
 /**
  * Creates an alias.
  *
@@ -113,27 +132,7 @@ inline auto create_alias(DSS::executor_t *p_ex, std::string id, std::string data
 	new_alias.value = data;
 
 	// Append it or replace it, but don't drop it
-	for (auto &element : alias_var->get_data())
-	{
-		try
-		{
-			lang::alias_t comp = std::any_cast<lang::alias_t>(element);
-			if (comp.id != id)
-			{
-				continue;
-			}
-
-			// Successful replace
-			element = new_alias;
-			return 0;
-		}
-		catch (std::bad_any_cast &_e)
-		{
-			return 0;
-		}
-	}
-
-	alias_var->append_data(new_alias);
+	alias_var->put_keyed(id, new_alias, alias_key);
 
 	return 0;
 }
@@ -143,47 +142,117 @@ const std::string NAME = "lang";
 namespace func
 {
 /**
- * Out will push arguments into the stdout stream.
+ * Out will push arguments into the output stream of the executor (stdout).
  */
 inline auto out(DSS::executor_t *p_ex, DSS::func_args_t args) -> DSS::return_type_t
 {
-	(void)p_ex;
+	std::ostream &output = p_ex->output();
 
 	for (auto argument : args)
 	{
-		std::cout << argument;
-		std::cout << " ";
+		output << argument;
+		output << " ";
 	}
 
-	std::cout << std::endl;
+	output << std::endl;
 
 	return 0;
 }
 
+/**
+ * Ls will push the entries of a directory into the stdout stream, as they are read.
+ *
+ * `ls [<dir>|<glob>] [limit <n>] [sort]`, where a glob may start with a
+ * directory (`logs/<glob>`). Paths are relative to the executor's directory.
+ */
 inline auto ls(DSS::executor_t *p_ex, DSS::func_args_t args) -> DSS::return_type_t
 {
-	(void)p_ex;
-	(void)args;
+	DSS::listing_options_t options = {};
+	std::string pattern = "";
 
-	for (const auto &dir_entry : std::filesystem::directory_iterator("."))
+	for (std::size_t i = 0; i < args.size(); i++)
 	{
-		std::string name = dir_entry.path().generic_string();
-		std::cout << name << std::endl;
+		if (args[i] == "sort")
+		{
+			options.sort = true;
+		}
+		else if (args[i] == "limit" && i + 1 < args.size())
+		{
+			DSS::ir::value_t limit = DSS::ir::parse_value(args[++i]);
+			if (std::holds_alternative<std::int64_t>(limit) == false || std::get<std::int64_t>(limit) <= 0)
+			{
+				return 2;
+			}
+			options.limit = std::size_t(std::get<std::int64_t>(limit));
+		}
+		else if (pattern.empty() == true)
+		{
+			pattern = args[i];
+		}
+		else
+		{
+			return 2;
+		}
 	}
 
-	return 0;
+	// Entries are printed with the directory they were listed from, like "./name"
+	std::string directory = ".";
+	std::error_code error;
+	std::size_t slash = pattern.rfind('/');
+	if (pattern.empty() == false && pattern.find_first_of("*?[") == std::string::npos &&
+		std::filesystem::is_directory(p_ex->resolve_path(pattern), error) == true)
+	{
+		directory = pattern;
+	}
+	else if (slash != std::string::npos)
+	{
+		directory = slash == 0 ? "/" : pattern.substr(0, slash);
+		options.pattern = pattern.substr(slash + 1);
+	}
+	else
+	{
+		options.pattern = pattern;
+	}
+	std::string prefix = directory.back() == '/' ? directory : directory + "/";
+
+	// Written in large blocks rather than flushed per entry
+	const std::size_t flush_size = 64 * 1024;
+	std::ostream &output = p_ex->output();
+	std::string out;
+	auto sink = [&out, &output, &prefix, flush_size](std::string_view name) {
+		out += prefix;
+		out += name;
+		out += '\n';
+		if (out.size() >= flush_size)
+		{
+			output.write(out.data(), std::streamsize(out.size()));
+			out.clear();
+		}
+	};
+
+	bool listed = DSS::list_directory(p_ex->resolve_path(directory), options, sink);
+	output.write(out.data(), std::streamsize(out.size()));
+	output.flush();
+
+	return listed == true ? 0 : 1;
 }
 
 /**
- * @brief This will set the filesystem.current_directory using argument 1
+ * @brief This will set the directory of the executor (and the current directory of the process) using argument 1
  */
 inline auto curdir(DSS::executor_t *p_ex, DSS::func_args_t args) -> DSS::return_type_t
 {
-	(void)p_ex;
-
-	if (std::filesystem::exists(args[0]) == false)
+	std::error_code error;
+	std::filesystem::path directory = std::filesystem::canonical(p_ex->resolve_path(args[0]), error);
+	if (error || std::filesystem::is_directory(directory, error) == false)
 		return 1;
-	std::filesystem::current_path(args[0]);
+
+	p_ex->set_directory(directory.string());
+	// Forks run on other threads, which share the directory of the process
+	if (p_ex->is_fork() == false)
+	{
+		std::filesystem::current_path(directory, error);
+	}
 
 	return 0;
 }
@@ -209,24 +278,112 @@ inline auto alias_def(DSS::executor_t *p_ex, DSS::func_args_t args) -> DSS::retu
 }
 
 /**
- * @brief Will not check for bad casts
+ * Aliases by id, for expanding a script in a single pass
+ */
+struct alias_index_t
+{
+	/**
+	 * Position of every alias in the order aliases apply: longest id
+	 * first, then first defined. A value only expands aliases which
+	 * apply after its own.
+	 */
+	std::unordered_map<std::string_view, std::pair<const alias_t *, std::size_t>> by_id;
+
+	/**
+	 * Distinct id lengths, longest first, so the longest id matches
+	 */
+	std::vector<std::size_t> lengths;
+};
+
+inline auto index_aliases(const std::vector<std::any> &elements) -> alias_index_t
+{
+	std::vector<const alias_t *> order = {};
+	order.reserve(elements.size());
+	for (const auto &element : elements)
+	{
+		order.push_back(&std::any_cast<const alias_t &>(element));
+	}
+	std::stable_sort(order.begin(), order.end(), [](const alias_t *a, const alias_t *b) { return a->id.length() > b->id.length(); });
+
+	alias_index_t res = {};
+	res.by_id.reserve(order.size());
+	for (std::size_t i = 0; i < order.size(); i++)
+	{
+		res.by_id.emplace(order[i]->id, std::make_pair(order[i], i));
+		if (res.lengths.empty() == true || res.lengths.back() != order[i]->id.length())
+		{
+			res.lengths.push_back(order[i]->id.length());
+		}
+	}
+
+	return res;
+}
+
+/**
+ * Expands every alias dereference of `text` into `out`
+ *
+ * @param after Only aliases which apply after this position are expanded (for values)
  *
- * @param a The first alias
- * @param b The second alias
- * @return true a.id.length() > b.id.length()
- * @return false a.id.length() < b.id.length()
+ * @return false if nothing was expanded. `out` is then left untouched,
+ * so that scripts without dereferences are never copied.
  */
-inline auto is_any_alias_id_greater(const std::any &a, const std::any &b) -> bool
+inline auto expand_aliases(std::string_view text, const alias_index_t &index, std::optional<std::size_t> after, std::string &out) -> bool
 {
-	const alias_t &aa = std::any_cast<alias_t>(a);
-	const alias_t &ab = std::any_cast<alias_t>(b);
+	bool expanded = false;
+	std::size_t start = 0;
+
+	for (std::size_t pos = text.find(ALIAS_DEREF); pos != std::string_view::npos; pos = text.find(ALIAS_DEREF, pos + 1))
+	{
+		if (pos < start)
+		{
+			continue; // Within the id of the previous dereference
+		}
+
+		const std::pair<const alias_t *, std::size_t> *found = nullptr;
+		std::string_view rest = text.substr(pos + ALIAS_DEREF.size());
+		for (std::size_t length : index.lengths)
+		{
+			if (length > rest.size())
+			{
+				continue;
+			}
+
+			auto match = index.by_id.find(rest.substr(0, length));
+			if (match != index.by_id.end() && (after.has_value() == false || match->second.second > after.value()))
+			{
+				found = &match->second;
+				break;
+			}
+		}
 
-	return (aa.id.length() > ab.id.length());
+		if (found == nullptr)
+		{
+			continue;
+		}
+
+		if (expanded == false)
+		{
+			out.reserve(out.size() + text.size());
+			expanded = true;
+		}
+		out.append(text.substr(start, pos - start));
+		if (expand_aliases(found->first->value, index, found->second, out) == false)
+		{
+			out.append(found->first->value);
+		}
+		start = pos + ALIAS_DEREF.size() + found->first->id.size();
+	}
+
+	if (expanded == true)
+	{
+		out.append(text.substr(start));
+	}
+	return expanded;
 }
 
 /**
  * Alias will apply defined aliases throughout
- * the script lazily.
+ * the script lazily, in a single pass.
  */
 inline auto alias(DSS::executor_t *p_ex, DSS::func_args_t args) -> DSS::return_type_t
 {
@@ -239,41 +396,173 @@ inline auto alias(DSS::executor_t *p_ex, DSS::func_args_t args) -> DSS::return_t
 	}
 
 	DSS::vars_t &vars = p_ex->get_vars();
-	std::shared_ptr<DSS::var_t<std::any>> alias_var = vars.get_var(ALIAS_VAR);
+	std::shared_ptr<const DSS::var_t<std::any>> alias_var = vars.get_var(ALIAS_VAR);
 	if (alias_var == nullptr)
 	{
 		return 1;
 	}
 
-	std::string &script = p_current_task->get_script();
+	if (p_current_task->view().find(ALIAS_DEREF) == std::string_view::npos)
+	{
+		return 0;
+	}
+
+	// A script read from a shared buffer is only copied once an alias actually changes it
+	std::string expanded = "";
+	if (expand_aliases(p_current_task->view(), index_aliases(alias_var->get_data()), std::nullopt, expanded) == true)
+	{
+		p_current_task->set_script(std::move(expanded));
+	}
+
+	return 0;
+}
+
+/**
+ * Let will assign a typed value to a variable. Values which are
+ * integers are stored as integers, anything else is stored as a string.
+ *
+ * Typed variables are read by control flow conditions, such as
+ * `if`, `while` and `repeat`.
+ */
+inline auto let(DSS::executor_t *p_ex, DSS::func_args_t args) -> DSS::return_type_t
+{
+	std::string id = args[0];
+	args.erase(args.begin());
+	std::string value;
+
+	for (std::size_t i = 0; i < args.size(); i++)
+	{
+		if (i > 0)
+		{
+			value += DSS::key::TOKEN_DELIM;
+		}
+		value += args[i];
+	}
+
+	DSS::ir::store_value(p_ex->get_vars(), id, DSS::ir::parse_value(value));
+
+	return 0;
+}
+
+/**
+ * Increment will add to an integer variable (1, unless
+ * an amount is provided). The amount may be negative.
+ */
+inline auto inc(DSS::executor_t *p_ex, DSS::func_args_t args) -> DSS::return_type_t
+{
+	std::int64_t amount = 1;
+
+	if (args.size() > 1)
+	{
+		DSS::ir::value_t parsed = DSS::ir::parse_value(args[1]);
+		if (std::holds_alternative<std::int64_t>(parsed) == false)
+		{
+			return 2;
+		}
+		amount = std::get<std::int64_t>(parsed);
+	}
+
+	std::optional<DSS::ir::value_t> current = DSS::ir::load_value(p_ex->get_vars(), args[0]);
+	if (current.has_value() == false || std::holds_alternative<std::int64_t>(current.value()) == false)
+	{
+		return 1;
+	}
+
+	DSS::ir::store_value(p_ex->get_vars(), args[0], std::get<std::int64_t>(current.value()) + amount);
+
+	return 0;
+}
+
+/**
+ * CPU will push the CPU time consumed by this executor into the stdout stream.
+ */
+inline auto cpu(DSS::executor_t *p_ex, DSS::func_args_t args) -> DSS::return_type_t
+{
+	(void)args;
+
+	const DSS::cpu_usage_t &usage = p_ex->get_cpu_usage();
+	auto to_us = [](std::chrono::nanoseconds time) { return std::chrono::duration_cast<std::chrono::microseconds>(time).count(); };
+
+	p_ex->output() << "executor " << p_ex->get_id() << ": " << usage.tasks << " tasks, " << usage.statements << " statements, " << to_us(usage.task_time) << "us task, "
+				   << to_us(usage.handler_time) << "us handler, " << to_us(usage.last_task_time) << "us last, " << to_us(usage.max_task_time) << "us max, "
+				   << usage.page_faults.minor << " minor faults, " << usage.page_faults.major << " major faults" << std::endl;
 
-	std::sort(alias_var->get_data().begin(), alias_var->get_data().end(), is_any_alias_id_greater);
+	return 0;
+}
 
-	for (auto element : alias_var->get_data())
+/**
+ * Incidents will push the slow commands recorded by the
+ * watchdog into the stdout stream, oldest first.
+ */
+inline auto incidents(DSS::executor_t *p_ex, DSS::func_args_t args) -> DSS::return_type_t
+{
+	(void)args;
+
+	std::optional<std::vector<DSS::incident_t>> res = DSS::watchdog_t::installed_incidents();
+	if (res.has_value() == false)
 	{
-		alias_t alias = std::any_cast<alias_t>(element);
+		return 1;
+	}
+
+	std::ostream &output = p_ex->output();
+	for (const auto &incident : res.value())
+	{
+		auto to_ms = [](std::chrono::nanoseconds time) { return std::chrono::duration_cast<std::chrono::milliseconds>(time).count(); };
 
-		std::string deref = ALIAS_DEREF + alias.id;
-		dss_utils::string_replace(script, deref, alias.value);
+		output << "incident " << incident.id << ": executor " << incident.run_id << ", line " << incident.line + 1 << ", " << to_ms(incident.elapsed)
+			   << "ms: " << incident.command;
+		for (const auto &argument : incident.args)
+		{
+			output << " " << argument;
+		}
+		output << std::endl;
+
+		for (const auto &frame : incident.stack)
+		{
+			output << "    " << frame << std::endl;
+		}
 	}
 
 	return 0;
 }
 
+/**
+ * Marks a `src` target as independent of other queued scripts
+ */
+const std::string SRC_INDEPENDENT = "independent";
+
 inline auto source(DSS::executor_t *p_ex, DSS::func_args_t args) -> DSS::return_type_t
 {
-	std::optional<std::string> res = dss_utils::file_read(args[0]);
+	bool independent = false;
+	if (args.size() > 1)
+	{
+		if (args[1] != SRC_INDEPENDENT)
+		{
+			return 3;
+		}
+		independent = true;
+	}
+
+	// Read rather than mapped: sourced files may be pipes, or be truncated while queued (see `DSS::map_script`)
+	std::string path = p_ex->resolve_path(args[0]);
+	std::optional<std::string> res = dss_utils::file_read(path);
 
 	// std::cout << std::filesystem::current_path();
-	// std::cout << res.has_value();
 
 	if (res.has_value() == false)
 	{
 		return 2;
 	}
 
-	DSS::task_t task = DSS::task_t(res.value());
-	p_ex->queue_task(task);
+	DSS::task_t task = DSS::task_t(std::move(res.value()));
+
+	if (independent == true)
+	{
+		p_ex->queue_independent_task(std::move(task));
+		return 0;
+	}
+
+	p_ex->queue_task(std::move(task));
 
 	return 0;
 }
@@ -284,7 +573,7 @@ inline auto source(DSS::executor_t *p_ex, DSS::func_args_t args) -> DSS::return_
  */
 inline std::any preprocessor_definer(DSS::executor_t *exec)
 {
-	exec->define_command(func::source, "src", "runs a dss script at path <path>", 1, 1);
+	exec->define_command(func::source, "src", "runs a dss script at path <path>, concurrently with other [independent] scripts", 1, 2);
 
 	exec->define_command(func::alias_def, "alias_def", "creates an alias", 2);
 
@@ -302,7 +591,15 @@ inline std::any command_definer(DSS::executor_t *exec)
 
 	exec->define_command(func::curdir, "cd", "changes the current directory", 1, 1);
 
-	exec->define_command(func::ls, "ls", "lists all files and directories in the current directory (.)", 0, 0);
+	exec->define_command(func::ls, "ls", "lists the entries of [dir] (default .), or those matching [glob], optionally [limit <n>] and [sort]ed", 0, 4);
+
+	exec->define_command(func::let, "let", "assigns a typed value to variable <id>", 2);
+
+	exec->define_command(func::inc, "inc", "adds [amount] (default 1) to integer variable <id>", 1, 2);
+
+	exec->define_command(func::cpu, "cpu", "reports the cpu time consumed by this executor", 0, 0);
+
+	exec->define_command(func::incidents, "incidents", "reports commands which the watchdog caught running slowly", 0, 0);
 
 	return nullptr;
 }
@@ -311,16 +608,24 @@ const std::string NULL_ENVIRONMENT =
 	"internal interpreter error, critical data unexpectedly returned null.\n\nnote: this error requires the attention of a developer";
 const DSS::err_codes_t OUT = {{1, NULL_ENVIRONMENT}};
 
-const DSS::err_codes_t SRC = {{1, NULL_ENVIRONMENT}, {2, "failed to queue script, file does not exist"}};
+const DSS::err_codes_t SRC = {
+	{1, NULL_ENVIRONMENT}, {2, "failed to queue script, file does not exist"}, {3, "unknown option, expected \"independent\""}};
 
 const DSS::err_codes_t ALIAS_DEF = {{1, NULL_ENVIRONMENT}};
 
 const DSS::err_codes_t ALIAS = {
 	{1, "internal interpreter error, automatic command failure, critical data unexpectedly returned null. \n\nhelp: did you mean \"alias_def\"?"}};
 
-const DSS::err_codes_t CURDIR = {{1, "file does not exist"}};
+const DSS::err_codes_t CURDIR = {{1, "directory does not exist"}};
+
+const DSS::err_codes_t LS = {{1, "cannot open directory"}, {2, "malformed option, expected \"limit <n>\" (n > 0) or \"sort\""}};
+
+const DSS::err_codes_t INC = {{1, "variable is not defined or is not an integer"}, {2, "amount must be an integer"}};
+
+const DSS::err_codes_t INCIDENTS = {{1, "no watchdog is running"}};
 
-const DSS::err_key_t ERR_KEY = {{"out", OUT}, {"src", SRC}, {"alias_def", ALIAS_DEF}, {"alias", ALIAS}, {"cd", CURDIR}};
+const DSS::err_key_t ERR_KEY = {
+	{"out", OUT}, {"src", SRC}, {"alias_def", ALIAS_DEF}, {"alias", ALIAS}, {"cd", CURDIR}, {"ls", LS}, {"inc", INC}, {"incidents", INCIDENTS}};
 
 }; // namespace lang
 
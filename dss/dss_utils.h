@@ -10,11 +10,14 @@
 
 #include <vector>
 #include <string>
+#include <string_view>
 #include <algorithm>
 #include <optional>
 #include <fstream>
 #include <sstream>
 #include <cstdint>
+#include <chrono>
+#include <ctime>
 
 namespace dss_utils
 {
@@ -27,19 +30,19 @@ namespace dss_utils
  *
  * @returns A vector of substrings after having been separated by delimiter.
  */
-inline std::vector<std::string> string_split(std::string s, const std::string &delimiter)
+inline std::vector<std::string> string_split(std::string_view s, const std::string &delimiter)
 {
 	std::vector<std::string> tokens;
+	std::size_t start = 0;
 	std::size_t pos = 0;
-	std::string token;
 
-	while ((pos = s.find(delimiter)) != std::string::npos)
+	// Searching onward from the previous token keeps this linear in the length of `s`
+	while ((pos = s.find(delimiter, start)) != std::string::npos)
 	{
-		token = s.substr(0, pos);
-		tokens.push_back(token);
-		s.erase(0, (pos + delimiter.length()));
+		tokens.emplace_back(s.substr(start, pos - start));
+		start = pos + delimiter.length();
 	}
-	tokens.push_back(s);
+	tokens.emplace_back(s.substr(start));
 
 	return tokens;
 }
@@ -52,15 +55,38 @@ inline std::vector<std::string> string_split(std::string s, const std::string &d
  * @param what The string to match occurences in `s`
  *
  * @param with The string to replace `what` with
+ *
+ * @note Replacements are not searched again, so `with`
+ * may contain `what`.
  */
-inline void string_replace(std::string &s, std::string &what, const std::string &with)
+inline void string_replace(std::string &s, const std::string &what, const std::string &with)
 {
-	std::size_t pos = 0;
+	if (what.empty() == true)
+	{
+		return;
+	}
+
+	std::size_t pos = s.find(what);
+	if (pos == std::string::npos)
+	{
+		return;
+	}
+
+	// Built in one pass, rather than shifting the tail of `s` for every occurence
+	std::string res;
+	res.reserve(s.size());
+	std::size_t start = 0;
 
-	while ((pos = s.find(what)) != std::string::npos)
+	while (pos != std::string::npos)
 	{
-		s.replace(pos, what.size(), with);
+		res.append(s, start, pos - start);
+		res += with;
+		start = pos + what.size();
+		pos = s.find(what, start);
 	}
+	res.append(s, start);
+
+	s.swap(res);
 }
 
 /**
@@ -86,6 +112,20 @@ inline std::optional<std::string> file_read(std::string &path)
 	return buf.str();
 }
 
+/**
+ * Reads the CPU time consumed by the calling thread.
+ *
+ * Unlike wall-clock time, this does not advance while the
+ * thread is blocked or preempted.
+ */
+inline auto thread_cpu_now() -> std::chrono::nanoseconds
+{
+	timespec ts = {};
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+
+	return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+}
+
 /**
  * Function pointers are connected to the delegate,
  * which can be called with the same arguments.
@@ -160,7 +200,7 @@ public:
 	 * behavior will not appear in the vector, and as such, relying on the fact that the number
 	 * of returns will be consistent is unsafe.
 	 */
-	template <typename... Ts> auto call(Ts... arg) -> R
+	template <typename... Ts> auto call(Ts... arg) const -> R
 	{
 		R res;
 
@@ -0,0 +1,389 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <unistd.h>
+
+#include "frame.h"
+
+namespace
+{
+
+/**
+ * Sequences which fit in the token alone. Longer ones are extended by
+ * bytes of 255, terminated by a smaller byte.
+ */
+const std::size_t RUN_MASK = 15;
+
+const std::size_t MIN_MATCH = 4;
+const std::size_t MAX_OFFSET = 65535;
+
+const unsigned HASH_BITS = 12;
+
+/**
+ * Compaction of the reader's buffer once its consumed part is this large
+ */
+const std::size_t COMPACT_SIZE = 64 * 1024;
+
+const std::size_t READ_SIZE = 64 * 1024;
+
+/**
+ * FNV-1a, as used by the journal
+ */
+auto checksum(const char *data, std::size_t size) -> std::uint32_t
+{
+	std::uint32_t res = 2166136261u;
+	for (std::size_t i = 0; i < size; i++)
+	{
+		res ^= std::uint8_t(data[i]);
+		res *= 16777619u;
+	}
+	return res;
+}
+
+void put_u32(std::string &out, std::uint32_t value)
+{
+	for (int i = 0; i < 4; i++)
+	{
+		out.push_back(char(value >> (8 * i)));
+	}
+}
+
+auto get_u32(const char *data) -> std::uint32_t
+{
+	std::uint32_t res = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		res |= std::uint32_t(std::uint8_t(data[i])) << (8 * i);
+	}
+	return res;
+}
+
+auto load_u32(const char *data) -> std::uint32_t
+{
+	std::uint32_t res;
+	std::memcpy(&res, data, sizeof(res));
+	return res;
+}
+
+auto hash(std::uint32_t sequence) -> std::uint32_t
+{
+	return (sequence * 2654435761u) >> (32 - HASH_BITS);
+}
+
+void put_length(std::string &out, std::size_t length)
+{
+	for (; length >= 255; length -= 255)
+	{
+		out.push_back(char(255));
+	}
+	out.push_back(char(length));
+}
+
+/**
+ * Appends one sequence: literals, then a match (unless `match` is 0,
+ * which only ends the block)
+ */
+void put_sequence(std::string &out, const char *literals, std::size_t count, std::size_t offset, std::size_t match)
+{
+	std::size_t match_code = match > 0 ? match - MIN_MATCH : 0;
+
+	out.push_back(char((std::min(count, RUN_MASK) << 4) | std::min(match_code, RUN_MASK)));
+	if (count >= RUN_MASK)
+	{
+		put_length(out, count - RUN_MASK);
+	}
+	out.append(literals, count);
+
+	if (match == 0)
+	{
+		return;
+	}
+
+	out.push_back(char(offset & 0xff));
+	out.push_back(char(offset >> 8));
+	if (match_code >= RUN_MASK)
+	{
+		put_length(out, match_code - RUN_MASK);
+	}
+}
+
+/**
+ * Reads the extension of a length from its token nibble
+ */
+auto get_length(const std::uint8_t *&in, const std::uint8_t *end, std::size_t &length) -> bool
+{
+	if (length != RUN_MASK)
+	{
+		return true;
+	}
+
+	std::uint8_t byte = 255;
+	while (byte == 255)
+	{
+		if (in == end)
+		{
+			return false;
+		}
+		byte = *in++;
+		length += byte;
+	}
+	return true;
+}
+
+} // namespace
+
+auto DSS::frame::compress(std::string_view data) -> std::string
+{
+	std::string res;
+	res.reserve(data.size() / 2 + 16);
+
+	const char *base = data.data();
+	std::size_t size = data.size();
+
+	// Positions (plus one, so that 0 is empty) of the last sequence seen per hash
+	std::uint32_t table[1 << HASH_BITS] = {};
+
+	std::size_t anchor = 0;
+	std::size_t pos = 0;
+
+	while (pos + MIN_MATCH <= size)
+	{
+		std::uint32_t sequence = load_u32(base + pos);
+		std::uint32_t &slot = table[hash(sequence)];
+		std::size_t candidate = slot;
+		slot = std::uint32_t(pos + 1);
+
+		if (candidate == 0 || pos - (candidate - 1) > MAX_OFFSET || load_u32(base + candidate - 1) != sequence)
+		{
+			// Skip faster through data which does not compress
+			pos += 1 + ((pos - anchor) >> 6);
+			continue;
+		}
+
+		std::size_t ref = candidate - 1;
+		std::size_t match = MIN_MATCH;
+		while (pos + match < size && base[ref + match] == base[pos + match])
+		{
+			match++;
+		}
+
+		put_sequence(res, base + anchor, pos - anchor, pos - ref, match);
+		pos += match;
+		anchor = pos;
+	}
+
+	put_sequence(res, base + anchor, size - anchor, 0, 0);
+	return res;
+}
+
+auto DSS::frame::decompress(std::string_view block, char *out, std::size_t size) -> bool
+{
+	const std::uint8_t *in = reinterpret_cast<const std::uint8_t *>(block.data());
+	const std::uint8_t *end = in + block.size();
+	std::size_t pos = 0;
+
+	while (in < end)
+	{
+		std::uint8_t token = *in++;
+
+		std::size_t count = token >> 4;
+		if (get_length(in, end, count) == false || count > std::size_t(end - in) || count > size - pos)
+		{
+			return false;
+		}
+		std::memcpy(out + pos, in, count);
+		in += count;
+		pos += count;
+
+		if (in == end)
+		{
+			break; // The last sequence holds literals only
+		}
+
+		if (end - in < 2)
+		{
+			return false;
+		}
+		std::size_t offset = std::size_t(in[0]) | (std::size_t(in[1]) << 8);
+		in += 2;
+
+		std::size_t match = token & RUN_MASK;
+		if (get_length(in, end, match) == false)
+		{
+			return false;
+		}
+		match += MIN_MATCH;
+
+		if (offset == 0 || offset > pos || match > size - pos)
+		{
+			return false;
+		}
+
+		if (offset >= match)
+		{
+			std::memcpy(out + pos, out + pos - offset, match);
+		}
+		else
+		{
+			// Overlapping matches repeat the last `offset` bytes
+			for (std::size_t i = 0; i < match; i++)
+			{
+				out[pos + i] = out[pos + i - offset];
+			}
+		}
+		pos += match;
+	}
+
+	return pos == size;
+}
+
+auto DSS::frame::encode(DSS::frame_type_t type, std::string_view payload, bool compress) -> std::string
+{
+	std::string packed;
+	bool compressed = false;
+	if (compress == true && payload.size() > MIN_MATCH)
+	{
+		packed = DSS::frame::compress(payload);
+		compressed = packed.size() < payload.size();
+	}
+
+	std::string_view body = compressed == true ? std::string_view(packed) : payload;
+
+	std::string res;
+	res.reserve(HEADER_SIZE + body.size());
+	res.append(MAGIC, sizeof(MAGIC));
+	res.push_back(char(type));
+	res.push_back(char(compressed == true ? FLAG_COMPRESSED : 0));
+	put_u32(res, std::uint32_t(payload.size()));
+	put_u32(res, std::uint32_t(body.size()));
+	put_u32(res, checksum(payload.data(), payload.size()));
+	res.append(body);
+	return res;
+}
+
+void DSS::frame_reader_t::feed(std::string_view bytes)
+{
+	if (m_failed == true)
+	{
+		return;
+	}
+
+	// Drop the frames already read, unless that would move more than it frees
+	if (m_offset == m_buffer.size())
+	{
+		m_buffer.clear();
+		m_offset = 0;
+	}
+	else if (m_offset >= COMPACT_SIZE && m_offset * 2 >= m_buffer.size())
+	{
+		m_buffer.erase(0, m_offset);
+		m_offset = 0;
+	}
+
+	m_buffer.append(bytes);
+}
+
+auto DSS::frame_reader_t::next() -> std::optional<DSS::frame_t>
+{
+	if (m_failed == true || buffered() < frame::HEADER_SIZE)
+	{
+		return std::nullopt;
+	}
+
+	const char *header = m_buffer.data() + m_offset;
+	std::uint8_t type = std::uint8_t(header[2]);
+	std::uint8_t flags = std::uint8_t(header[3]);
+	std::size_t size = get_u32(header + 4);
+	std::size_t length = get_u32(header + 8);
+	std::uint32_t sum = get_u32(header + 12);
+	bool compressed = (flags & frame::FLAG_COMPRESSED) != 0;
+
+	bool valid = std::memcmp(header, frame::MAGIC, sizeof(frame::MAGIC)) == 0;
+	valid = valid && (type == std::uint8_t(frame_type_t::SCRIPT) || type == std::uint8_t(frame_type_t::PACKET));
+	valid = valid && (flags & ~frame::FLAG_COMPRESSED) == 0 && size <= m_max_size;
+	valid = valid && (compressed == true ? length < size : length == size); // Payloads are only compressed if that helps
+	if (valid == false)
+	{
+		m_failed = true;
+		return std::nullopt;
+	}
+
+	if (buffered() - frame::HEADER_SIZE < length)
+	{
+		return std::nullopt; // Not fully received yet
+	}
+
+	std::string_view body(m_buffer.data() + m_offset + frame::HEADER_SIZE, length);
+
+	frame_t res;
+	res.type = frame_type_t(type);
+	if (compressed == true)
+	{
+		// Decoded once, into the buffer the task will run from
+		res.payload.resize(size);
+		valid = frame::decompress(body, res.payload.data(), size);
+	}
+	else
+	{
+		res.payload.assign(body);
+	}
+
+	if (valid == false || checksum(res.payload.data(), res.payload.size()) != sum)
+	{
+		m_failed = true;
+		return std::nullopt;
+	}
+
+	m_offset += frame::HEADER_SIZE + length;
+	return res;
+}
+
+auto DSS::serve_frames(int fd, DSS::executor_t &executor, DSS::packet_handler_t on_packet, std::size_t max_size) -> bool
+{
+	DSS::frame_reader_t reader(max_size);
+	char chunk[READ_SIZE];
+
+	while (true)
+	{
+		ssize_t res = read(fd, chunk, sizeof(chunk));
+		if (res < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (res < 0)
+		{
+			DSS::push_error(DSS::frame::err::READ);
+			return false;
+		}
+		if (res == 0)
+		{
+			if (reader.buffered() > 0)
+			{
+				DSS::push_error(DSS::frame::err::TRUNCATED);
+				return false;
+			}
+			return true;
+		}
+
+		reader.feed(std::string_view(chunk, std::size_t(res)));
+
+		while (std::optional<DSS::frame_t> frame = reader.next())
+		{
+			if (frame->type == DSS::frame_type_t::SCRIPT)
+			{
+				executor.exec(std::move(frame->payload));
+			}
+			else if (on_packet != nullptr)
+			{
+				on_packet(std::move(frame->payload));
+			}
+		}
+
+		if (reader.failed() == true)
+		{
+			DSS::push_error(DSS::frame::err::CORRUPT);
+			return false;
+		}
+	}
+}
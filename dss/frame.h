@@ -0,0 +1,148 @@
+/**
+ * This file contains the framing of the script transport, through which
+ * front ends (links, sockets, pipes) send scripts and binary packets.
+ *
+ * Every frame carries a header, and a payload which may be compressed
+ * with a small built-in LZ77 codec (in the manner of LZ4: literal runs
+ * and back-references of at most 64 KiB). Repetitive scripts, such as
+ * bulk trajectory uploads, shrink several times over. Compressed payloads
+ * are decoded straight into the buffer of the task which runs them.
+ *
+ * Frame layout (little-endian):
+ *
+ *   magic   2 bytes  'D' 'F'
+ *   type    1 byte   frame_type_t
+ *   flags   1 byte   FLAG_COMPRESSED
+ *   size    4 bytes  decoded payload size
+ *   length  4 bytes  payload size on the wire
+ *   check   4 bytes  FNV-1a of the decoded payload
+ *   payload
+ */
+
+#ifndef H_FRAME
+#define H_FRAME
+
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "runtime.h"
+
+namespace DSS
+{
+
+enum class frame_type_t : std::uint8_t
+{
+	/**
+	 * Executed by the executor of the front end
+	 */
+	SCRIPT = 1,
+
+	/**
+	 * Handed to the front end's packet handler
+	 */
+	PACKET = 2,
+};
+
+namespace frame
+{
+
+const char MAGIC[2] = {'D', 'F'};
+const std::size_t HEADER_SIZE = 16;
+
+const std::uint8_t FLAG_COMPRESSED = 1;
+
+/**
+ * Largest decoded payload accepted by default
+ */
+const std::size_t DEFAULT_MAX_SIZE = 64 * 1024 * 1024;
+
+namespace err
+{
+const std::string CORRUPT = "corrupt frame, the stream cannot be resynchronised";
+const std::string TRUNCATED = "stream ended within a frame";
+const std::string READ = "cannot read the frame stream";
+} // namespace err
+
+/**
+ * Compresses a block
+ */
+auto compress(std::string_view data) -> std::string;
+
+/**
+ * Decompresses a block into exactly `size` bytes at `out`
+ *
+ * @return false if the block is malformed, or does not decode to `size` bytes
+ */
+auto decompress(std::string_view block, char *out, std::size_t size) -> bool;
+
+/**
+ * Encodes a frame. The payload is only stored compressed if that makes
+ * it smaller.
+ */
+auto encode(frame_type_t type, std::string_view payload, bool compress = true) -> std::string;
+
+} // namespace frame
+
+struct frame_t
+{
+	frame_type_t type = frame_type_t::SCRIPT;
+	std::string payload = "";
+};
+
+/**
+ * Splits a byte stream into frames
+ */
+class frame_reader_t
+{
+public:
+	frame_reader_t(std::size_t max_size = frame::DEFAULT_MAX_SIZE) { m_max_size = max_size; }
+
+	/**
+	 * Appends received bytes
+	 */
+	void feed(std::string_view bytes);
+
+	/**
+	 * @return The next complete frame, or std::nullopt if it has not been
+	 * fully received (or the stream is corrupt, see `failed`)
+	 */
+	auto next() -> std::optional<frame_t>;
+
+	/**
+	 * A corrupt stream cannot be resynchronised, and yields no more frames
+	 */
+	auto failed() -> bool { return m_failed; }
+
+	/**
+	 * @return The amount of buffered bytes, not yet part of a frame
+	 */
+	auto buffered() -> std::size_t { return m_buffer.size() - m_offset; }
+
+private:
+	std::string m_buffer;
+
+	/**
+	 * Start of the first incomplete frame in `m_buffer`
+	 */
+	std::size_t m_offset = 0;
+
+	std::size_t m_max_size = frame::DEFAULT_MAX_SIZE;
+	bool m_failed = false;
+};
+
+typedef std::function<void(std::string &&)> packet_handler_t;
+
+/**
+ * Reads frames from a file descriptor (a socket, pipe or serial link)
+ * until the end of the stream. Scripts are executed by `executor`,
+ * packets are handed to `on_packet` (if any).
+ *
+ * @return false if the stream is corrupt or cannot be read
+ */
+auto serve_frames(int fd, executor_t &executor, packet_handler_t on_packet = nullptr, std::size_t max_size = frame::DEFAULT_MAX_SIZE) -> bool;
+
+} // namespace DSS
+
+#endif // H_FRAME
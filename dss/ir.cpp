@@ -0,0 +1,346 @@
+#include <charconv>
+
+#include "ir.h"
+
+auto DSS::ir::parse_value(const std::string &token) -> DSS::ir::value_t
+{
+	std::int64_t res = 0;
+	const char *begin = token.data();
+	const char *end = token.data() + token.size();
+
+	auto [ptr, ec] = std::from_chars(begin, end, res);
+
+	if (token.empty() == true || ec != std::errc() || ptr != end)
+	{
+		return token;
+	}
+
+	return res;
+}
+
+auto DSS::ir::load_value(DSS::vars_t &vars, const std::string &id) -> std::optional<DSS::ir::value_t>
+{
+	std::shared_ptr<const DSS::var_t<std::any>> var = vars.get_var(id);
+
+	if (var == nullptr || var->get_data().size() != 1)
+	{
+		return std::nullopt;
+	}
+
+	const std::any &element = var->get_data()[0];
+
+	if (element.type() == typeid(std::int64_t))
+	{
+		return std::any_cast<std::int64_t>(element);
+	}
+	if (element.type() == typeid(std::string))
+	{
+		return std::any_cast<std::string>(element);
+	}
+
+	return std::nullopt;
+}
+
+void DSS::ir::store_value(DSS::vars_t &vars, const std::string &id, DSS::ir::value_t value)
+{
+	std::shared_ptr<DSS::var_t<std::any>> var = vars.get_or_add_var(id);
+
+	std::vector<std::any> &data = var->get_data();
+	data.clear();
+
+	if (std::holds_alternative<std::int64_t>(value) == true)
+	{
+		data.push_back(std::get<std::int64_t>(value));
+		return;
+	}
+
+	data.push_back(std::get<std::string>(value));
+}
+
+namespace
+{
+
+auto parse_cmp(const std::string &token) -> std::optional<DSS::ir::cmp_t>
+{
+	using DSS::ir::cmp_t;
+
+	if (token == "==")
+		return cmp_t::EQ;
+	if (token == "!=")
+		return cmp_t::NE;
+	if (token == "<")
+		return cmp_t::LT;
+	if (token == "<=")
+		return cmp_t::LE;
+	if (token == ">")
+		return cmp_t::GT;
+	if (token == ">=")
+		return cmp_t::GE;
+
+	return std::nullopt;
+}
+
+/**
+ * Integers are literals, anything else refers to a variable
+ */
+auto parse_operand(const std::string &token) -> DSS::ir::operand_t
+{
+	DSS::ir::operand_t res = {};
+	DSS::ir::value_t value = DSS::ir::parse_value(token);
+
+	if (std::holds_alternative<std::int64_t>(value) == true)
+	{
+		res.literal = value;
+		return res;
+	}
+
+	res.is_var = true;
+	res.id = token;
+	return res;
+}
+
+auto resolve(const DSS::ir::operand_t &operand, DSS::vars_t &vars) -> std::optional<DSS::ir::value_t>
+{
+	if (operand.is_var == false)
+	{
+		return operand.literal;
+	}
+
+	return DSS::ir::load_value(vars, operand.id);
+}
+
+auto to_string(const DSS::ir::value_t &value) -> std::string
+{
+	if (std::holds_alternative<std::int64_t>(value) == true)
+	{
+		return std::to_string(std::get<std::int64_t>(value));
+	}
+
+	return std::get<std::string>(value);
+}
+
+template <typename T> auto compare(const T &a, DSS::ir::cmp_t cmp, const T &b) -> bool
+{
+	using DSS::ir::cmp_t;
+
+	switch (cmp)
+	{
+	case cmp_t::EQ:
+		return a == b;
+	case cmp_t::NE:
+		return a != b;
+	case cmp_t::LT:
+		return a < b;
+	case cmp_t::LE:
+		return a <= b;
+	case cmp_t::GT:
+		return a > b;
+	case cmp_t::GE:
+		return a >= b;
+	}
+
+	return false;
+}
+
+/**
+ * An open control flow block, awaiting its `end`
+ */
+struct block_t
+{
+	std::string keyword;
+
+	/**
+	 * Instruction whose `target` is patched when the block closes
+	 * (or, for `if`, when `else` is reached)
+	 */
+	std::size_t patch;
+
+	/**
+	 * Instruction to jump back to at `end` (loops)
+	 */
+	std::size_t loop_start;
+
+	std::int64_t line;
+};
+
+} // namespace
+
+auto DSS::ir::compile(const DSS::strvec_t &statements, const std::deque<DSS::command_t> &commands, bool control_flow, DSS::ir::program_t &program)
+	-> bool
+{
+	program.code.clear();
+	program.code.reserve(statements.size());
+	program.counter_slots = 0;
+
+	// The most recently defined command of a name takes precedence
+	std::unordered_map<std::string, std::size_t> names = {};
+	for (std::size_t i = 0; i < commands.size(); i++)
+	{
+		names[commands[i].get_name()] = i;
+	}
+
+	std::vector<block_t> blocks = {};
+	std::int64_t line = -1;
+
+	for (const auto &statement : statements)
+	{
+		line++;
+		DSS::strvec_t parsed = dss_utils::string_split(statement, DSS::key::TOKEN_DELIM);
+
+		// No command
+		if (parsed.size() == 0)
+		{
+			continue;
+		}
+
+		const std::string &keyword = parsed[0];
+
+		if (control_flow == true && (keyword == key::IF || keyword == key::WHILE))
+		{
+			std::optional<cmp_t> cmp = std::nullopt;
+			if (parsed.size() == 4)
+			{
+				cmp = parse_cmp(parsed[2]);
+			}
+			if (cmp.has_value() == false)
+			{
+				DSS::push_error(err::BAD_CONDITION, line);
+				return false;
+			}
+
+			instr_t branch = {};
+			branch.op = op_t::BRANCH;
+			branch.line = line;
+			branch.cond.lhs = parse_operand(parsed[1]);
+			branch.cond.cmp = cmp.value();
+			branch.cond.rhs = parse_operand(parsed[3]);
+
+			blocks.push_back({keyword, program.code.size(), program.code.size(), line});
+			program.code.push_back(branch);
+			continue;
+		}
+
+		if (control_flow == true && keyword == key::REPEAT)
+		{
+			if (parsed.size() != 2)
+			{
+				DSS::push_error(err::BAD_COUNT, line);
+				return false;
+			}
+
+			instr_t init = {};
+			init.op = op_t::REPEAT_INIT;
+			init.line = line;
+			init.count = parse_operand(parsed[1]);
+			init.slot = program.counter_slots;
+			program.code.push_back(init);
+
+			instr_t step = {};
+			step.op = op_t::REPEAT_STEP;
+			step.line = line;
+			step.slot = program.counter_slots;
+
+			blocks.push_back({keyword, program.code.size(), program.code.size(), line});
+			program.code.push_back(step);
+			program.counter_slots++;
+			continue;
+		}
+
+		if (control_flow == true && keyword == key::ELSE)
+		{
+			if (blocks.empty() == true || blocks.back().keyword != key::IF)
+			{
+				DSS::push_error(err::UNMATCHED_ELSE, line);
+				return false;
+			}
+
+			instr_t jump = {};
+			jump.op = op_t::JUMP;
+			jump.line = line;
+			program.code.push_back(jump);
+
+			// A false condition now lands after the jump, in the `else` body
+			block_t &block = blocks.back();
+			program.code[block.patch].target = program.code.size();
+			block.keyword = key::ELSE;
+			block.patch = program.code.size() - 1;
+			continue;
+		}
+
+		if (control_flow == true && keyword == key::END)
+		{
+			if (blocks.empty() == true)
+			{
+				DSS::push_error(err::UNMATCHED_END, line);
+				return false;
+			}
+
+			block_t block = blocks.back();
+			blocks.pop_back();
+
+			if (block.keyword == key::WHILE || block.keyword == key::REPEAT)
+			{
+				instr_t jump = {};
+				jump.op = op_t::JUMP;
+				jump.line = line;
+				jump.target = block.loop_start;
+				program.code.push_back(jump);
+			}
+
+			program.code[block.patch].target = program.code.size();
+			continue;
+		}
+
+		auto found = names.find(keyword);
+		if (found == names.end())
+		{
+			continue; // Command does not exist
+		}
+
+		instr_t call = {};
+		call.op = op_t::CALL;
+		call.line = line;
+		call.command = found->second;
+		call.keyword = keyword;
+		call.args.assign(parsed.begin() + 1, parsed.end());
+		program.code.push_back(std::move(call));
+	}
+
+	if (blocks.empty() == false)
+	{
+		DSS::push_error(err::UNTERMINATED_BLOCK, blocks.back().line);
+		return false;
+	}
+
+	return true;
+}
+
+auto DSS::ir::evaluate(const DSS::ir::condition_t &cond, DSS::vars_t &vars) -> std::optional<bool>
+{
+	std::optional<value_t> lhs = resolve(cond.lhs, vars);
+	std::optional<value_t> rhs = resolve(cond.rhs, vars);
+
+	if (lhs.has_value() == false || rhs.has_value() == false)
+	{
+		return std::nullopt;
+	}
+
+	if (std::holds_alternative<std::int64_t>(lhs.value()) == true && std::holds_alternative<std::int64_t>(rhs.value()) == true)
+	{
+		return compare(std::get<std::int64_t>(lhs.value()), cond.cmp, std::get<std::int64_t>(rhs.value()));
+	}
+
+	return compare(to_string(lhs.value()), cond.cmp, to_string(rhs.value()));
+}
+
+auto DSS::ir::resolve_int(const DSS::ir::operand_t &operand, DSS::vars_t &vars) -> std::optional<std::int64_t>
+{
+	std::optional<value_t> value = resolve(operand, vars);
+
+	if (value.has_value() == false || std::holds_alternative<std::int64_t>(value.value()) == false)
+	{
+		return std::nullopt;
+	}
+
+	return std::get<std::int64_t>(value.value());
+}
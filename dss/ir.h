@@ -0,0 +1,185 @@
+/**
+ * This file contains the compiled statement stream ("IR") of DSS.
+ *
+ * Statements of the "command" pass are lexed and resolved against
+ * the loaded commands exactly once, then executed by index. Control
+ * flow (`if`, `else`, `while`, `repeat`, `end`) is compiled into jumps
+ * within the stream, so loops never re-lex or re-dispatch by name.
+ */
+
+#ifndef H_IR
+#define H_IR
+
+#include <variant>
+
+#include "runtime.h"
+
+namespace DSS
+{
+namespace ir
+{
+
+namespace key
+{
+const std::string IF = "if";
+const std::string ELSE = "else";
+const std::string WHILE = "while";
+const std::string REPEAT = "repeat";
+const std::string END = "end";
+} // namespace key
+
+namespace err
+{
+const std::string UNMATCHED_END = "\"end\" without a matching \"if\", \"while\" or \"repeat\"";
+const std::string UNMATCHED_ELSE = "\"else\" without a matching \"if\"";
+const std::string UNTERMINATED_BLOCK = "block is missing a terminating \"end\"";
+const std::string BAD_CONDITION = "malformed condition, expected <lhs> <==|!=|<|<=|>|>=> <rhs>";
+const std::string BAD_COUNT = "malformed repeat count, expected an integer or an integer variable";
+const std::string UNDEFINED_VAR = "variable is not defined";
+} // namespace err
+
+/**
+ * A typed value. Variables created by `let` hold
+ * exactly one of these.
+ */
+typedef std::variant<std::int64_t, std::string> value_t;
+
+/**
+ * Parses a token into a typed value. Tokens which are entirely
+ * an integer become integers, anything else remains a string.
+ */
+auto parse_value(const std::string &token) -> value_t;
+
+/**
+ * Retrieves the typed value of the variable `id`.
+ *
+ * @return std::nullopt if the variable does not exist or is not typed.
+ */
+auto load_value(vars_t &vars, const std::string &id) -> std::optional<value_t>;
+
+/**
+ * Stores a typed value into the variable `id`, creating it if required.
+ */
+void store_value(vars_t &vars, const std::string &id, value_t value);
+
+enum class op_t : std::uint8_t
+{
+	CALL,		 // Dispatch a resolved command
+	JUMP,		 // Unconditionally continue at `target`
+	BRANCH,		 // Continue at `target` if `cond` is false
+	REPEAT_INIT, // Load `count` into counter `slot`
+	REPEAT_STEP, // Continue at `target` if counter `slot` is exhausted, otherwise decrement it
+};
+
+enum class cmp_t : std::uint8_t
+{
+	EQ,
+	NE,
+	LT,
+	LE,
+	GT,
+	GE,
+};
+
+/**
+ * Either a literal or a reference to a variable,
+ * resolved when the instruction executes.
+ */
+struct operand_t
+{
+	bool is_var = false;
+	std::string id = "";
+	value_t literal = std::int64_t(0);
+};
+
+struct condition_t
+{
+	operand_t lhs;
+	cmp_t cmp = cmp_t::EQ;
+	operand_t rhs;
+};
+
+struct instr_t
+{
+	op_t op = op_t::CALL;
+
+	/**
+	 * The line of the statement this instruction was compiled from
+	 */
+	std::int64_t line = -1;
+
+	/**
+	 * Index of the command within the executor's loaded commands (CALL)
+	 */
+	std::size_t command = 0;
+
+	/**
+	 * The keyword of the statement (CALL). Kept for error lookup.
+	 */
+	std::string keyword = "";
+
+	/**
+	 * Arguments, already lexed (CALL)
+	 */
+	func_args_t args = {};
+
+	/**
+	 * Jump destination (JUMP, BRANCH, REPEAT_STEP)
+	 */
+	std::size_t target = 0;
+
+	condition_t cond = {};
+
+	operand_t count = {};
+
+	std::size_t slot = 0;
+};
+
+/**
+ * A compiled statement stream
+ */
+struct program_t
+{
+	std::vector<instr_t> code = {};
+
+	/**
+	 * The amount of `repeat` counters the program requires
+	 */
+	std::size_t counter_slots = 0;
+};
+
+/**
+ * Compiles statements into a program.
+ *
+ * @param statements The statements of a pass
+ *
+ * @param commands The commands loaded for the pass. Statements whose keyword
+ * does not match a command are dropped, as they would never execute.
+ *
+ * @param control_flow Whether control flow keywords are compiled. When false,
+ * they are treated like any other keyword.
+ *
+ * @param program Receives the compiled program
+ *
+ * @return false if the statements could not be compiled. The error has been pushed.
+ */
+auto compile(const strvec_t &statements, const std::deque<command_t> &commands, bool control_flow, program_t &program) -> bool;
+
+/**
+ * Evaluates a condition against the variables of an executor.
+ *
+ * @return std::nullopt if an operand could not be resolved
+ */
+auto evaluate(const condition_t &cond, vars_t &vars) -> std::optional<bool>;
+
+/**
+ * Resolves an operand to an integer.
+ *
+ * @return std::nullopt if the operand is not (or does not refer to) an integer
+ */
+auto resolve_int(const operand_t &operand, vars_t &vars) -> std::optional<std::int64_t>;
+
+} // namespace ir
+} // namespace DSS
+
+#endif // H_IR
@@ -0,0 +1,424 @@
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "journal.h"
+#include "snapshot.h"
+
+namespace
+{
+
+const char LOG_MAGIC[4] = {'D', 'S', 'S', 'W'};
+const char SNAP_MAGIC[4] = {'D', 'S', 'S', 'J'};
+
+/**
+ * Magic, format version and generation
+ */
+const std::size_t LOG_HEADER_SIZE = sizeof(LOG_MAGIC) + sizeof(std::uint32_t) + sizeof(std::uint64_t);
+
+/**
+ * Length and checksum of a record
+ */
+const std::size_t RECORD_HEADER_SIZE = 2 * sizeof(std::uint32_t);
+
+/**
+ * FNV-1a, to detect records torn by a crash
+ */
+auto checksum(const char *data, std::size_t size) -> std::uint32_t
+{
+	std::uint32_t res = 2166136261u;
+	for (std::size_t i = 0; i < size; i++)
+	{
+		res ^= std::uint8_t(data[i]);
+		res *= 16777619u;
+	}
+	return res;
+}
+
+auto write_all(int fd, const char *data, std::size_t size) -> bool
+{
+	while (size > 0)
+	{
+		ssize_t res = write(fd, data, size);
+		if (res < 0)
+		{
+			return false;
+		}
+		data += res;
+		size -= std::size_t(res);
+	}
+	return true;
+}
+
+/**
+ * Makes the creation or renaming of a file within the directory durable
+ */
+auto sync_directory(const std::string &path) -> bool
+{
+	std::string directory = std::filesystem::path(path).parent_path().string();
+	int fd = open(directory.empty() == true ? "." : directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	bool res = fsync(fd) == 0;
+	close(fd);
+	return res;
+}
+
+auto log_header(std::uint64_t generation) -> std::string
+{
+	std::string res(LOG_MAGIC, sizeof(LOG_MAGIC));
+	res.append(reinterpret_cast<const char *>(&DSS::snapshot::FORMAT_VERSION), sizeof(std::uint32_t));
+	res.append(reinterpret_cast<const char *>(&generation), sizeof(generation));
+	return res;
+}
+
+/**
+ * Read-only mapping of a whole file
+ */
+struct mapping_t
+{
+	const char *data = nullptr;
+	std::size_t size = 0;
+
+	mapping_t(const std::string &path)
+	{
+		int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+		{
+			return;
+		}
+
+		struct stat info = {};
+		if (fstat(fd, &info) == 0 && info.st_size > 0)
+		{
+			void *mapped = mmap(nullptr, std::size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+			if (mapped != MAP_FAILED)
+			{
+				data = static_cast<const char *>(mapped);
+				size = std::size_t(info.st_size);
+			}
+		}
+		close(fd);
+	}
+
+	~mapping_t()
+	{
+		if (data != nullptr)
+		{
+			munmap(const_cast<char *>(data), size);
+		}
+	}
+};
+
+} // namespace
+
+DSS::journal_t::journal_t(std::string path, DSS::journal_options_t options)
+{
+	m_path = path;
+	m_options = options;
+}
+
+DSS::journal_t::~journal_t()
+{
+	if (m_executor != nullptr)
+	{
+		m_executor->set_journal(nullptr);
+	}
+
+	if (m_thread.joinable() == true)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stopping = true;
+		}
+		m_wake.notify_all();
+		m_thread.join();
+	}
+
+	if (m_fd >= 0)
+	{
+		close(m_fd);
+	}
+}
+
+auto DSS::journal_t::replay(DSS::executor_t &executor) -> bool
+{
+	std::string log_path = m_path + ".wal";
+	std::size_t valid = 0;
+
+	{
+		mapping_t snap(m_path + ".snap");
+		if (snap.size >= sizeof(SNAP_MAGIC) + sizeof(std::uint64_t) && std::memcmp(snap.data, SNAP_MAGIC, sizeof(SNAP_MAGIC)) == 0)
+		{
+			std::memcpy(&m_generation, snap.data + sizeof(SNAP_MAGIC), sizeof(std::uint64_t));
+
+			std::size_t offset = sizeof(SNAP_MAGIC) + sizeof(std::uint64_t);
+			DSS::snapshot::decode(snap.data + offset, snap.size - offset, executor.get_vars());
+		}
+	}
+
+	mapping_t log(log_path);
+	if (log.size < LOG_HEADER_SIZE || std::memcmp(log.data, log_header(m_generation).data(), LOG_HEADER_SIZE) != 0)
+	{
+		// Missing, or superseded by the snapshot
+		return false;
+	}
+
+	valid = LOG_HEADER_SIZE;
+	std::string id;
+	std::vector<std::any> elements;
+
+	while (log.size - valid >= RECORD_HEADER_SIZE)
+	{
+		std::uint32_t length = 0;
+		std::uint32_t sum = 0;
+		std::memcpy(&length, log.data + valid, sizeof(length));
+		std::memcpy(&sum, log.data + valid + sizeof(length), sizeof(sum));
+
+		const char *payload = log.data + valid + RECORD_HEADER_SIZE;
+		std::size_t remaining = log.size - valid - RECORD_HEADER_SIZE;
+		if (length > remaining || checksum(payload, length) != sum)
+		{
+			break; // Torn by a crash
+		}
+
+		std::size_t size = length;
+		if (DSS::snapshot::decode_var(payload, size, id, elements) == false)
+		{
+			break;
+		}
+
+		executor.get_vars().get_or_add_var(id)->get_data() = elements;
+		valid += RECORD_HEADER_SIZE + length;
+	}
+
+	m_log_bytes = valid;
+
+	// Drop the torn tail, so new records follow the last valid one
+	return truncate(log_path.c_str(), off_t(valid)) == 0;
+}
+
+auto DSS::journal_t::attach(DSS::executor_t &executor) -> bool
+{
+	if (m_fd >= 0)
+	{
+		return false;
+	}
+
+	bool replayed = replay(executor);
+	std::string log_path = m_path + ".wal";
+
+	if (replayed == true)
+	{
+		m_fd = open(log_path.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+	}
+	else
+	{
+		m_fd = open(log_path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+		std::string header = log_header(m_generation);
+		if (m_fd >= 0 && (write_all(m_fd, header.data(), header.size()) == false || fdatasync(m_fd) != 0 || sync_directory(log_path) == false))
+		{
+			close(m_fd);
+			m_fd = -1;
+		}
+		m_log_bytes = header.size();
+	}
+
+	if (m_fd < 0)
+	{
+		return false;
+	}
+
+	for (const auto &var : executor.get_vars().all())
+	{
+		m_logged_stamps[var->get_id()] = var->get_stamp();
+	}
+
+	m_thread = std::thread(&DSS::journal_t::commit_loop, this);
+	m_executor = &executor;
+	executor.set_journal(this);
+
+	return true;
+}
+
+void DSS::journal_t::capture(DSS::vars_t &vars)
+{
+	std::string records;
+	std::size_t count = 0;
+
+	for (std::shared_ptr<const DSS::var_t<std::any>> var : vars.all())
+	{
+		DSS::var_stamp_t &logged = m_logged_stamps[var->get_id()];
+		if (logged == var->get_stamp())
+		{
+			continue;
+		}
+		logged = var->get_stamp();
+
+		std::size_t start = records.size();
+		records.append(RECORD_HEADER_SIZE, '\0');
+		DSS::snapshot::encode_var(*var, records);
+
+		std::uint32_t length = std::uint32_t(records.size() - start - RECORD_HEADER_SIZE);
+		std::uint32_t sum = checksum(records.data() + start + RECORD_HEADER_SIZE, length);
+		std::memcpy(records.data() + start, &length, sizeof(length));
+		std::memcpy(records.data() + start + sizeof(length), &sum, sizeof(sum));
+		count++;
+	}
+
+	if (count == 0 && m_resync.load() == false)
+	{
+		return;
+	}
+
+	bool wake = false;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		m_log_bytes += records.size();
+		m_stats.records += count;
+
+		if (m_log_bytes > m_options.compact_bytes || m_resync.exchange(false) == true)
+		{
+			// The snapshot contains every buffered record, and those of a failed commit
+			m_pending_snapshot = DSS::snapshot::encode(vars);
+			m_buffer.clear();
+			m_buffered_records = 0;
+			m_log_bytes = LOG_HEADER_SIZE;
+			wake = true;
+		}
+		else
+		{
+			m_buffer += records;
+			m_buffered_records += count;
+			wake = m_buffered_records >= m_options.batch;
+		}
+	}
+
+	if (wake == true)
+	{
+		m_wake.notify_one();
+	}
+}
+
+auto DSS::journal_t::commit() -> bool
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	if (m_thread.joinable() == false)
+	{
+		return false;
+	}
+
+	std::uint64_t target = ++m_requested;
+	m_wake.notify_one();
+	m_committed.wait(lock, [this, target] { return m_completed >= target; });
+
+	return m_resync.load() == false;
+}
+
+auto DSS::journal_t::stats() -> DSS::journal_stats_t
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+auto DSS::journal_t::write_group(std::optional<std::string> &snapshot, const std::string &records) -> bool
+{
+	if (snapshot.has_value() == true)
+	{
+		std::uint64_t generation = m_generation + 1;
+		std::string snap_path = m_path + ".snap";
+		std::string temporary = snap_path + ".tmp";
+
+		int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+		if (fd < 0)
+		{
+			return false;
+		}
+
+		bool written = write_all(fd, SNAP_MAGIC, sizeof(SNAP_MAGIC)) && write_all(fd, reinterpret_cast<const char *>(&generation), sizeof(generation)) &&
+					   write_all(fd, snapshot.value().data(), snapshot.value().size()) && fsync(fd) == 0;
+		close(fd);
+
+		if (written == false || std::rename(temporary.c_str(), snap_path.c_str()) != 0 || sync_directory(snap_path) == false)
+		{
+			return false;
+		}
+
+		// Until the new header is written, the old log is ignored, as its generation is outdated
+		m_generation = generation;
+		std::string header = log_header(generation);
+		if (ftruncate(m_fd, 0) != 0 || write_all(m_fd, header.data(), header.size()) == false)
+		{
+			return false;
+		}
+	}
+
+	if (write_all(m_fd, records.data(), records.size()) == false)
+	{
+		return false;
+	}
+
+	return fdatasync(m_fd) == 0;
+}
+
+void DSS::journal_t::commit_loop()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	while (true)
+	{
+		m_wake.wait_for(lock, m_options.interval, [this] {
+			return m_stopping == true || m_buffered_records >= m_options.batch || m_pending_snapshot.has_value() == true || m_requested > m_completed;
+		});
+
+		std::string records;
+		records.swap(m_buffer);
+		std::size_t count = m_buffered_records;
+		m_buffered_records = 0;
+
+		std::optional<std::string> snapshot = std::nullopt;
+		snapshot.swap(m_pending_snapshot);
+
+		std::uint64_t requested = m_requested;
+		bool stopping = m_stopping;
+
+		if (count > 0 || snapshot.has_value() == true)
+		{
+			lock.unlock();
+			bool res = write_group(snapshot, records);
+			lock.lock();
+
+			m_stats.commits++;
+			if (snapshot.has_value() == true)
+			{
+				m_stats.compactions++;
+			}
+			if (res == false)
+			{
+				// Records buffered meanwhile would follow a torn one, and the snapshot supersedes them
+				m_stats.failures++;
+				m_buffer.clear();
+				m_buffered_records = 0;
+				m_resync = true;
+			}
+		}
+
+		m_completed = requested;
+		m_committed.notify_all();
+
+		if (stopping == true)
+		{
+			return;
+		}
+	}
+}
@@ -0,0 +1,167 @@
+/**
+ * This file contains the variable journal, an optional durability
+ * layer for executor variables.
+ *
+ * Whenever a task completes, every variable it modified is appended
+ * to a write-ahead log. Records are buffered and committed in groups
+ * by a background thread (one fdatasync per group), so executors never
+ * wait on the disk. The log is periodically compacted into a snapshot.
+ */
+
+#ifndef H_JOURNAL
+#define H_JOURNAL
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "runtime.h"
+
+namespace DSS
+{
+
+struct journal_options_t
+{
+	/**
+	 * Commit as soon as this many records are buffered
+	 */
+	std::size_t batch = 256;
+
+	/**
+	 * Commit buffered records at least this often
+	 */
+	std::chrono::milliseconds interval = std::chrono::milliseconds(10);
+
+	/**
+	 * Fold the log into a snapshot once it grows past this size
+	 */
+	std::size_t compact_bytes = 4 * 1024 * 1024;
+};
+
+struct journal_stats_t
+{
+	std::uint64_t records = 0;
+	std::uint64_t commits = 0;
+	std::uint64_t compactions = 0;
+
+	/**
+	 * Failed writes or syncs. The records of a failed commit are not
+	 * retried; the next capture writes a snapshot of every variable instead.
+	 */
+	std::uint64_t failures = 0;
+};
+
+class journal_t
+{
+public:
+	/**
+	 * @param path Base path of the journal. The log is kept at `<path>.wal`
+	 * and its snapshot at `<path>.snap`.
+	 */
+	journal_t(std::string path, journal_options_t options = journal_options_t());
+
+	/**
+	 * Commits anything buffered, then stops the commit thread.
+	 * The executor stops being journaled.
+	 */
+	~journal_t();
+
+	journal_t(const journal_t &) = delete;
+	journal_t &operator=(const journal_t &) = delete;
+
+	/**
+	 * Restores the executor's variables from the snapshot and log (if
+	 * they exist), then starts journaling the executor.
+	 *
+	 * @return false if the log could not be opened
+	 */
+	auto attach(executor_t &executor) -> bool;
+
+	/**
+	 * Buffers a record for every variable modified or replaced since the
+	 * last capture. Called by the executor whenever a task completes, and
+	 * once the results of its forked tasks are merged. After a failed
+	 * commit, it buffers a snapshot of every variable instead.
+	 */
+	void capture(vars_t &vars);
+
+	/**
+	 * Commits every buffered record, and waits until it is durable.
+	 *
+	 * @return false if a commit failed and has not been recovered from yet.
+	 * Variables captured so far may then be lost, until the next capture.
+	 */
+	auto commit() -> bool;
+
+	auto stats() -> journal_stats_t;
+
+private:
+	std::string m_path;
+	journal_options_t m_options;
+
+	executor_t *m_executor = nullptr;
+
+	int m_fd = -1;
+
+	/**
+	 * Log records are only valid for the snapshot of the same generation
+	 */
+	std::uint64_t m_generation = 0;
+
+	/**
+	 * Stamps of variables as of their most recent record. Stamps
+	 * rather than versions, as a variable which is recreated (such as
+	 * by loading a snapshot) starts its versions over.
+	 * Only touched by the journaled executor's thread.
+	 */
+	std::map<std::string, var_stamp_t> m_logged_stamps;
+
+	/**
+	 * Bytes written to the log since it was last compacted
+	 */
+	std::size_t m_log_bytes = 0;
+
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_committed;
+
+	std::string m_buffer;
+	std::size_t m_buffered_records = 0;
+
+	/**
+	 * Set when a commit fails. Its records are not in the log, and the
+	 * variables are not captured again until they change, so the next
+	 * capture snapshots every variable instead.
+	 */
+	std::atomic<bool> m_resync = false;
+
+	/**
+	 * A snapshot awaiting the commit thread. Supersedes the log.
+	 */
+	std::optional<std::string> m_pending_snapshot = std::nullopt;
+
+	/**
+	 * Incremented when a commit is requested or completed
+	 */
+	std::uint64_t m_requested = 0;
+	std::uint64_t m_completed = 0;
+
+	bool m_stopping = false;
+	std::thread m_thread;
+
+	journal_stats_t m_stats = {};
+
+	void commit_loop();
+
+	/**
+	 * Writes the snapshot (if any) and the records. Runs on the commit thread.
+	 */
+	auto write_group(std::optional<std::string> &snapshot, const std::string &records) -> bool;
+
+	auto replay(executor_t &executor) -> bool;
+};
+
+} // namespace DSS
+
+#endif // H_JOURNAL
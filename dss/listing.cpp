@@ -0,0 +1,146 @@
+#include <algorithm>
+#include <queue>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <unistd.h>
+
+#include "listing.h"
+
+namespace
+{
+
+/**
+ * Bytes of entries read per system call
+ */
+const std::size_t BATCH_SIZE = 64 * 1024;
+
+} // namespace
+
+DSS::directory_reader_t::directory_reader_t(const std::string &path)
+{
+	m_fd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (m_fd >= 0)
+	{
+		m_buffer = std::make_unique<char[]>(BATCH_SIZE);
+	}
+}
+
+DSS::directory_reader_t::~directory_reader_t()
+{
+	if (m_fd >= 0)
+	{
+		close(m_fd);
+	}
+}
+
+auto DSS::directory_reader_t::next() -> std::optional<std::string_view>
+{
+	while (true)
+	{
+		if (m_offset >= m_size)
+		{
+			if (m_fd < 0 || m_done == true)
+			{
+				return std::nullopt;
+			}
+
+			ssize_t res = getdents64(m_fd, m_buffer.get(), BATCH_SIZE);
+			if (res <= 0)
+			{
+				m_done = true;
+				return std::nullopt;
+			}
+			m_size = std::size_t(res);
+			m_offset = 0;
+		}
+
+		const dirent64 *entry = reinterpret_cast<const dirent64 *>(m_buffer.get() + m_offset);
+		m_offset += entry->d_reclen;
+
+		std::string_view name = entry->d_name;
+		if (name != "." && name != "..")
+		{
+			return name;
+		}
+	}
+}
+
+auto DSS::list_directory(const std::string &path, const DSS::listing_options_t &options, const DSS::listing_sink_t &sink) -> bool
+{
+	DSS::directory_reader_t reader(path);
+	if (reader.is_open() == false)
+	{
+		return false;
+	}
+
+	auto matches = [&options](std::string_view name) {
+		return options.pattern.empty() == true || fnmatch(options.pattern.c_str(), name.data(), FNM_PERIOD) == 0;
+	};
+
+	if (options.sort == false)
+	{
+		std::size_t count = 0;
+		while (std::optional<std::string_view> name = reader.next())
+		{
+			if (matches(*name) == false)
+			{
+				continue;
+			}
+
+			sink(*name);
+			if (++count == options.limit)
+			{
+				break;
+			}
+		}
+		return true;
+	}
+
+	std::vector<std::string> names = {};
+
+	if (options.limit == 0)
+	{
+		while (std::optional<std::string_view> name = reader.next())
+		{
+			if (matches(*name) == true)
+			{
+				names.emplace_back(*name);
+			}
+		}
+		std::sort(names.begin(), names.end());
+	}
+	else
+	{
+		// Only the first `limit` names are kept, largest on top
+		std::priority_queue<std::string> first = {};
+		while (std::optional<std::string_view> name = reader.next())
+		{
+			if (matches(*name) == false || (first.size() == options.limit && *name >= first.top()))
+			{
+				continue;
+			}
+
+			first.emplace(*name);
+			if (first.size() > options.limit)
+			{
+				first.pop();
+			}
+		}
+
+		names.resize(first.size());
+		for (std::size_t i = names.size(); i > 0; i--)
+		{
+			names[i - 1] = first.top();
+			first.pop();
+		}
+	}
+
+	for (const std::string &name : names)
+	{
+		sink(name);
+	}
+	return true;
+}
@@ -0,0 +1,96 @@
+/**
+ * This file contains the directory listing engine behind `ls`.
+ *
+ * Entries are read in batches straight from the kernel (`getdents64`,
+ * 64 KiB at a time) and handed to a sink as they are read, so listing a
+ * directory of a million files neither stats them nor keeps their names.
+ * Only sorted listings collect names, and sorted listings with a limit
+ * only keep the first `limit` of them.
+ */
+
+#ifndef H_LISTING
+#define H_LISTING
+
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace DSS
+{
+
+/**
+ * Reads the names of a directory's entries, in directory order
+ */
+class directory_reader_t
+{
+public:
+	/**
+	 * Opens a directory. Check `is_open` before reading.
+	 */
+	directory_reader_t(const std::string &path);
+
+	~directory_reader_t();
+
+	directory_reader_t(const directory_reader_t &) = delete;
+	directory_reader_t &operator=(const directory_reader_t &) = delete;
+
+	auto is_open() -> bool { return m_fd >= 0; }
+
+	/**
+	 * @return The name of the next entry ("." and ".." excluded), null
+	 * terminated and valid until the next call, or std::nullopt once
+	 * every entry was read
+	 */
+	auto next() -> std::optional<std::string_view>;
+
+private:
+	int m_fd = -1;
+
+	std::unique_ptr<char[]> m_buffer;
+
+	/**
+	 * Bytes of `m_buffer` filled by the last batch, and read so far
+	 */
+	std::size_t m_size = 0;
+	std::size_t m_offset = 0;
+
+	bool m_done = false;
+};
+
+struct listing_options_t
+{
+	/**
+	 * Glob (`*`, `?`, `[...]`) the names must match. Names starting
+	 * with a dot only match patterns which start with a dot. Empty
+	 * for every entry.
+	 */
+	std::string pattern = "";
+
+	/**
+	 * The most entries listed, or 0 for every entry
+	 */
+	std::size_t limit = 0;
+
+	/**
+	 * Lists the entries by name, rather than in directory order
+	 */
+	bool sort = false;
+};
+
+/**
+ * Receives the name of every listed entry
+ */
+typedef std::function<void(std::string_view name)> listing_sink_t;
+
+/**
+ * Lists a directory into a sink
+ *
+ * @return false if the directory cannot be opened
+ */
+auto list_directory(const std::string &path, const listing_options_t &options, const listing_sink_t &sink) -> bool;
+
+} // namespace DSS
+
+#endif // H_LISTING
@@ -0,0 +1,317 @@
+#include <algorithm>
+#include <iostream>
+
+#include <pthread.h>
+
+#include "log.h"
+
+struct DSS::logger_t::ring_t
+{
+	std::vector<DSS::log_record_t> slots;
+	std::uint64_t mask = 0;
+
+	/**
+	 * Advanced by the writer thread
+	 */
+	alignas(64) std::atomic<std::uint64_t> head = 0;
+
+	/**
+	 * Advanced by the owning thread
+	 */
+	alignas(64) std::atomic<std::uint64_t> tail = 0;
+
+	/**
+	 * Token bucket of the rate limit, only touched by the owning thread
+	 */
+	double tokens = 0.0;
+	std::chrono::steady_clock::time_point refilled = {};
+
+	ring_t(std::size_t capacity, std::uint32_t rate_limit)
+	{
+		std::size_t size = 1;
+		while (size < capacity)
+		{
+			size *= 2;
+		}
+
+		slots.resize(size);
+		mask = size - 1;
+		tokens = double(rate_limit);
+		refilled = std::chrono::steady_clock::now();
+	}
+};
+
+DSS::logger_t::logger_t() {}
+
+DSS::logger_t::~logger_t() { stop(); }
+
+auto DSS::logger() -> DSS::logger_t &
+{
+	static DSS::logger_t instance;
+	static bool registered = [] {
+		pthread_atfork(nullptr, nullptr, DSS::logger_t::after_fork);
+		return true;
+	}();
+	(void)registered;
+
+	return instance;
+}
+
+void DSS::logger_t::after_fork()
+{
+	DSS::logger_t &instance = logger();
+
+	instance.m_running.store(false, std::memory_order_release);
+
+	// The writer thread does not exist in the child, so it can be neither joined nor destroyed
+	new (&instance.m_thread) std::thread();
+	new (&instance.m_mutex) std::mutex();
+	instance.m_rings.clear();
+}
+
+void DSS::logger_t::start(DSS::log_options_t options)
+{
+	if (m_running.load(std::memory_order_acquire) == true)
+	{
+		return;
+	}
+
+	m_options = options;
+	m_level.store(options.level, std::memory_order_relaxed);
+	m_stopping = false;
+
+	m_thread = std::thread(&DSS::logger_t::write_loop, this);
+	m_running.store(true, std::memory_order_release);
+}
+
+void DSS::logger_t::stop()
+{
+	if (m_running.load(std::memory_order_acquire) == false)
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_wake.notify_all();
+	m_thread.join();
+
+	m_running.store(false, std::memory_order_release);
+
+	// Records pushed while the writer thread stopped
+	drain();
+}
+
+auto DSS::logger_t::ring() -> DSS::logger_t::ring_t &
+{
+	thread_local std::vector<std::pair<const DSS::logger_t *, std::shared_ptr<ring_t>>> t_rings = {};
+
+	for (const auto &[logger, ring] : t_rings)
+	{
+		if (logger == this)
+		{
+			return *ring;
+		}
+	}
+
+	std::shared_ptr<ring_t> res = std::make_shared<ring_t>(m_options.ring_capacity, m_options.rate_limit);
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_rings.push_back(res);
+	}
+	t_rings.emplace_back(this, res);
+
+	return *res;
+}
+
+void DSS::logger_t::push(DSS::log_level_t level, std::string message, std::int64_t line)
+{
+	if (level < m_level.load(std::memory_order_relaxed))
+	{
+		return;
+	}
+
+	DSS::log_record_t record = {};
+	record.level = level;
+	record.line = line;
+	record.message = std::move(message);
+
+	if (m_running.load(std::memory_order_acquire) == false)
+	{
+		write(format_record(record));
+		m_written.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	ring_t &ring = this->ring();
+
+	if (m_options.rate_limit > 0)
+	{
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		double limit = double(m_options.rate_limit);
+
+		ring.tokens = std::min(limit, ring.tokens + std::chrono::duration<double>(now - ring.refilled).count() * limit);
+		ring.refilled = now;
+
+		if (ring.tokens < 1.0)
+		{
+			m_dropped_rate.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		ring.tokens -= 1.0;
+	}
+
+	std::uint64_t tail = ring.tail.load(std::memory_order_relaxed);
+	if (tail - ring.head.load(std::memory_order_acquire) > ring.mask)
+	{
+		m_dropped_full.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	ring.slots[tail & ring.mask] = std::move(record);
+	ring.tail.store(tail + 1, std::memory_order_release);
+}
+
+void DSS::logger_t::flush()
+{
+	if (m_running.load(std::memory_order_acquire) == false)
+	{
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	std::uint64_t target = ++m_requested;
+	m_wake.notify_all();
+	m_drained.wait(lock, [this, target] { return m_completed >= target; });
+}
+
+auto DSS::logger_t::stats() -> DSS::log_stats_t
+{
+	DSS::log_stats_t res = {};
+	res.written = m_written.load(std::memory_order_relaxed);
+	res.dropped_full = m_dropped_full.load(std::memory_order_relaxed);
+	res.dropped_rate = m_dropped_rate.load(std::memory_order_relaxed);
+	return res;
+}
+
+void DSS::logger_t::write_loop()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	while (true)
+	{
+		m_wake.wait_for(lock, m_options.interval, [this] { return m_stopping == true || m_requested > m_completed; });
+
+		std::uint64_t requested = m_requested;
+		bool stopping = m_stopping;
+
+		lock.unlock();
+		drain();
+		lock.lock();
+
+		m_completed = requested;
+		m_drained.notify_all();
+
+		if (stopping == true)
+		{
+			return;
+		}
+	}
+}
+
+void DSS::logger_t::drain()
+{
+	std::vector<std::shared_ptr<ring_t>> rings = {};
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		rings = m_rings;
+	}
+
+	std::string text;
+	std::uint64_t written = 0;
+
+	for (auto &ring : rings)
+	{
+		std::uint64_t head = ring->head.load(std::memory_order_relaxed);
+		std::uint64_t tail = ring->tail.load(std::memory_order_acquire);
+
+		for (; head < tail; head++)
+		{
+			DSS::log_record_t &record = ring->slots[head & ring->mask];
+			text += format_record(record);
+			record.message.clear();
+			written++;
+		}
+
+		ring->head.store(tail, std::memory_order_release);
+	}
+
+	std::uint64_t dropped = m_dropped_full.load(std::memory_order_relaxed) + m_dropped_rate.load(std::memory_order_relaxed);
+	if (dropped > m_reported_drops)
+	{
+		DSS::log_record_t record = {};
+		record.level = DSS::log_level_t::WARNING;
+		record.message = std::to_string(dropped - m_reported_drops) + " log records dropped";
+		text += format_record(record);
+		m_reported_drops = dropped;
+	}
+
+	if (text.empty() == false)
+	{
+		write(text);
+	}
+	m_written.fetch_add(written, std::memory_order_relaxed);
+
+	// Forget the rings of threads which exited (no longer referenced by their thread), once they are empty
+	rings.clear();
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::erase_if(m_rings, [](const std::shared_ptr<ring_t> &ring) {
+		return ring.use_count() == 1 && ring->head.load(std::memory_order_relaxed) == ring->tail.load(std::memory_order_acquire);
+	});
+}
+
+void DSS::logger_t::write(const std::string &text)
+{
+	if (m_writer != nullptr)
+	{
+		m_writer(text);
+		return;
+	}
+
+	std::cout << text << std::flush;
+}
+
+auto DSS::format_record(const DSS::log_record_t &record) -> std::string
+{
+	std::string res;
+
+	switch (record.level)
+	{
+	case DSS::log_level_t::ERROR:
+		res = "\nerror: a critical exception occurred";
+		if (record.line > -1)
+		{
+			res += " on line " + std::to_string(record.line + 1);
+		}
+		return res + "\n" + record.message + "\n";
+	case DSS::log_level_t::WARNING:
+		res = "[warning] ";
+		break;
+	case DSS::log_level_t::INFO:
+		res = "[info] ";
+		break;
+	case DSS::log_level_t::DEBUG:
+		res = "[debug] ";
+		break;
+	}
+
+	res += record.message;
+	if (record.line > -1)
+	{
+		res += " (line " + std::to_string(record.line + 1) + ")";
+	}
+
+	return res + "\n";
+}
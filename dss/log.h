@@ -0,0 +1,205 @@
+/**
+ * This file contains the logger of DSS, which carries errors and
+ * diagnostics from executors to the terminal.
+ *
+ * Once started, every thread pushes records into its own lock-free
+ * ring, and a background thread formats and writes them, so threads
+ * never block on terminal I/O. Records are filtered by level and rate
+ * limited per thread; whatever overflows a ring or exceeds the rate
+ * limit is dropped and counted.
+ *
+ * Until it is started (and in forked processes), records are written
+ * synchronously by the thread which pushes them.
+ */
+
+#ifndef H_LOG
+#define H_LOG
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace DSS
+{
+
+enum class log_level_t : std::uint8_t
+{
+	DEBUG,
+	INFO,
+	WARNING,
+	ERROR,
+};
+
+struct log_options_t
+{
+	/**
+	 * Records below this level are discarded
+	 */
+	log_level_t level = log_level_t::INFO;
+
+	/**
+	 * Records buffered per thread. Rounded up to a power of two.
+	 */
+	std::size_t ring_capacity = 1024;
+
+	/**
+	 * Records accepted per second and thread (in bursts of as many).
+	 * Zero disables rate limiting.
+	 */
+	std::uint32_t rate_limit = 1000;
+
+	/**
+	 * How often the rings are drained
+	 */
+	std::chrono::milliseconds interval = std::chrono::milliseconds(5);
+};
+
+struct log_stats_t
+{
+	std::uint64_t written = 0;
+
+	/**
+	 * Records lost because the ring of their thread was full
+	 */
+	std::uint64_t dropped_full = 0;
+
+	/**
+	 * Records lost to rate limiting
+	 */
+	std::uint64_t dropped_rate = 0;
+};
+
+/**
+ * Receives formatted records
+ */
+typedef std::function<void(const std::string &)> log_writer_t;
+
+struct log_record_t
+{
+	log_level_t level = log_level_t::INFO;
+	std::int64_t line = -1;
+	std::string message = "";
+};
+
+class logger_t
+{
+public:
+	logger_t();
+
+	/**
+	 * Writes anything buffered
+	 */
+	~logger_t();
+
+	logger_t(const logger_t &) = delete;
+	logger_t &operator=(const logger_t &) = delete;
+
+	/**
+	 * Starts writing records asynchronously
+	 */
+	void start(log_options_t options = log_options_t());
+
+	/**
+	 * Writes anything buffered, then writes synchronously again
+	 */
+	void stop();
+
+	/**
+	 * @param line The line of the statement the record concerns, or -1
+	 */
+	void push(log_level_t level, std::string message, std::int64_t line = -1);
+
+	/**
+	 * Waits until every record pushed by the calling thread is written
+	 */
+	void flush();
+
+	void set_level(log_level_t level) { m_level.store(level, std::memory_order_relaxed); }
+
+	/**
+	 * Replaces where records are written (`std::cout` by default).
+	 * An empty writer restores the default.
+	 *
+	 * @note Not thread-safe: only set while no other thread pushes records.
+	 */
+	void set_writer(log_writer_t writer) { m_writer = std::move(writer); }
+
+	auto stats() -> log_stats_t;
+
+	/**
+	 * A single-producer, single-consumer ring of records
+	 */
+	struct ring_t;
+
+private:
+	log_options_t m_options;
+	log_writer_t m_writer;
+	std::atomic<log_level_t> m_level = log_level_t::INFO;
+
+	/**
+	 * False until started, and in forked processes, which lack the writer thread
+	 */
+	std::atomic<bool> m_running = false;
+
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_drained;
+	bool m_stopping = false;
+
+	/**
+	 * Incremented when a drain is requested or completed
+	 */
+	std::uint64_t m_requested = 0;
+	std::uint64_t m_completed = 0;
+
+	std::vector<std::shared_ptr<ring_t>> m_rings;
+	std::thread m_thread;
+
+	std::atomic<std::uint64_t> m_written = 0;
+	std::atomic<std::uint64_t> m_dropped_full = 0;
+	std::atomic<std::uint64_t> m_dropped_rate = 0;
+
+	/**
+	 * Drops already reported by the writer thread
+	 */
+	std::uint64_t m_reported_drops = 0;
+
+	auto ring() -> ring_t &;
+
+	void write_loop();
+
+	/**
+	 * Formats and writes every buffered record
+	 */
+	void drain();
+
+	void write(const std::string &text);
+
+	/**
+	 * Only the forking thread survives a fork
+	 */
+	static void after_fork();
+
+	friend auto logger() -> logger_t &;
+};
+
+/**
+ * @return The logger of the process
+ */
+auto logger() -> logger_t &;
+
+/**
+ * Formats a record the way it is written
+ */
+auto format_record(const log_record_t &record) -> std::string;
+
+} // namespace DSS
+
+#endif // H_LOG
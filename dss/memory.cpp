@@ -0,0 +1,118 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+
+#include <malloc.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "memory.h"
+
+namespace
+{
+
+const std::uintptr_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+std::mutex g_heap_mutex;
+bool g_heap_configured = false;
+
+auto faults(int who) -> DSS::page_faults_t
+{
+	rusage usage = {};
+	if (getrusage(who, &usage) != 0)
+	{
+		return {};
+	}
+
+	return {std::uint64_t(usage.ru_minflt), std::uint64_t(usage.ru_majflt)};
+}
+
+/**
+ * @return A field of a /proc file given in kB (e.g. "VmLck:"), in bytes
+ */
+auto proc_field(const char *path, const char *field) -> std::uint64_t
+{
+	std::FILE *file = std::fopen(path, "r");
+	if (file == nullptr)
+	{
+		return 0;
+	}
+
+	std::size_t length = std::strlen(field);
+	char line[256];
+	unsigned long long res = 0;
+	while (std::fgets(line, sizeof(line), file) != nullptr)
+	{
+		if (std::strncmp(line, field, length) == 0)
+		{
+			std::sscanf(line + length, "%llu", &res);
+			break;
+		}
+	}
+	std::fclose(file);
+
+	return res * 1024;
+}
+
+} // namespace
+
+auto DSS::memory::page_faults() -> DSS::page_faults_t { return faults(RUSAGE_SELF); }
+
+auto DSS::memory::thread_page_faults() -> DSS::page_faults_t { return faults(RUSAGE_THREAD); }
+
+auto DSS::memory::reserve_heap(std::size_t bytes, DSS::huge_pages_t huge_pages) -> bool
+{
+	std::lock_guard<std::mutex> lock(g_heap_mutex);
+
+	if (g_heap_configured == false)
+	{
+		// Freed memory is never returned to the system, and large blocks are not mapped
+		// separately, so the reserve serves every later allocation. Threads share the main
+		// heap, as others would only fault in their own.
+		mallopt(M_TRIM_THRESHOLD, -1);
+		mallopt(M_MMAP_MAX, 0);
+		mallopt(M_ARENA_MAX, 1);
+		g_heap_configured = true;
+	}
+
+	if (bytes == 0)
+	{
+		return true;
+	}
+
+	char *block = static_cast<char *>(std::malloc(bytes));
+	if (block == nullptr)
+	{
+		return false;
+	}
+
+	bool res = true;
+	if (huge_pages == DSS::huge_pages_t::TRANSPARENT)
+	{
+		// Only whole huge pages within the block can be advised
+		std::uintptr_t begin = (reinterpret_cast<std::uintptr_t>(block) + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+		std::uintptr_t end = (reinterpret_cast<std::uintptr_t>(block) + bytes) & ~(HUGE_PAGE_SIZE - 1);
+		if (end > begin)
+		{
+			res = madvise(reinterpret_cast<void *>(begin), end - begin, MADV_HUGEPAGE) == 0;
+		}
+	}
+
+	std::size_t page = std::size_t(sysconf(_SC_PAGESIZE));
+	volatile char *touch = block;
+	for (std::size_t i = 0; i < bytes; i += page)
+	{
+		touch[i] = 0;
+	}
+
+	std::free(block);
+	return res;
+}
+
+auto DSS::memory::lock() -> bool { return mlockall(MCL_CURRENT | MCL_FUTURE) == 0; }
+
+auto DSS::memory::locked_bytes() -> std::uint64_t { return proc_field("/proc/self/status", "VmLck:"); }
+
+auto DSS::memory::huge_page_bytes() -> std::uint64_t { return proc_field("/proc/self/smaps_rollup", "AnonHugePages:"); }
@@ -0,0 +1,126 @@
+/**
+ * This file contains the memory reservation of real-time executors.
+ *
+ * Memory touched for the first time page faults, which shows up as
+ * latency spikes in control executors. Reserving memory up front sizes
+ * the task queues and variable stores of every executor, grows the heap
+ * by a reserve per executor and touches every page of it, so that later
+ * allocations are served from memory which is already mapped. Optionally,
+ * the reserve is backed by transparent huge pages, and every page of the
+ * process is locked in memory (`mlockall`).
+ *
+ * Page faults are counted per executor while memory is reserved, and
+ * for the process as a whole, to verify the mode.
+ */
+
+#ifndef H_MEMORY
+#define H_MEMORY
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace DSS
+{
+
+enum class huge_pages_t
+{
+	NONE,
+
+	/**
+	 * The heap reserve is advised (`MADV_HUGEPAGE`) to be backed by
+	 * transparent huge pages. Requires THP in "madvise" or "always" mode.
+	 */
+	TRANSPARENT,
+};
+
+struct memory_options_t
+{
+	/**
+	 * Bytes of heap reserved and prefaulted per executor
+	 */
+	std::size_t heap = 0;
+
+	/**
+	 * Queued tasks per executor which do not allocate
+	 */
+	std::size_t tasks = 0;
+
+	/**
+	 * Variables per executor which do not grow the variable store
+	 */
+	std::size_t vars = 0;
+
+	huge_pages_t huge_pages = huge_pages_t::NONE;
+
+	/**
+	 * Locks every current and future page of the process in memory
+	 * (`mlockall`). Thread stacks and heap growth are then faulted in
+	 * when they are mapped, rather than on first touch. Requires
+	 * CAP_IPC_LOCK, or a sufficient RLIMIT_MEMLOCK.
+	 */
+	bool lock = false;
+};
+
+struct page_faults_t
+{
+	/**
+	 * Faults served without I/O, such as the first touch of a page
+	 */
+	std::uint64_t minor = 0;
+
+	/**
+	 * Faults which had to read a page from disk
+	 */
+	std::uint64_t major = 0;
+};
+
+namespace memory
+{
+
+namespace err
+{
+const std::string RESERVE = "cannot reserve the heap, or advise it to use huge pages";
+const std::string LOCK = "cannot lock memory, CAP_IPC_LOCK or a larger RLIMIT_MEMLOCK is required";
+} // namespace err
+
+/**
+ * @return The page faults of the process so far
+ */
+auto page_faults() -> page_faults_t;
+
+/**
+ * @return The page faults of the calling thread so far
+ */
+auto thread_page_faults() -> page_faults_t;
+
+/**
+ * Keeps freed memory in the heap, serves every allocation (large ones
+ * included) from a single heap shared by every thread, grows it to hold
+ * at least `bytes` free and touches every page of it.
+ *
+ * @note This changes the allocator for the whole process, trading
+ * multi-threaded allocation throughput for predictable latency.
+ */
+auto reserve_heap(std::size_t bytes, huge_pages_t huge_pages) -> bool;
+
+/**
+ * Locks every current and future page of the process in memory
+ */
+auto lock() -> bool;
+
+/**
+ * @return Bytes of memory locked by the process
+ */
+auto locked_bytes() -> std::uint64_t;
+
+/**
+ * @return Bytes of anonymous memory backed by transparent huge pages
+ */
+auto huge_page_bytes() -> std::uint64_t;
+
+} // namespace memory
+
+} // namespace DSS
+
+#endif // H_MEMORY
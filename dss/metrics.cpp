@@ -0,0 +1,685 @@
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "log.h"
+#include "metrics.h"
+#include "scheduler.h"
+#include "work_pool.h"
+
+namespace
+{
+
+/**
+ * Every bucket of a histogram, +Inf included
+ */
+const std::size_t BUCKET_COUNT = DSS::metrics::LATENCY_BUCKETS.size() + 1;
+
+/**
+ * Longest request accepted by the exporter
+ */
+const std::size_t MAX_REQUEST = 8192;
+
+/**
+ * Increments a counter which only the calling thread writes. A plain
+ * load and store is enough, and avoids a locked instruction.
+ */
+inline void bump(std::atomic<std::uint64_t> &counter, std::uint64_t amount = 1)
+{
+	counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+struct histogram_t
+{
+	/**
+	 * Not cumulative, unlike the exposition format
+	 */
+	std::array<std::atomic<std::uint64_t>, BUCKET_COUNT> buckets = {};
+	std::atomic<std::uint64_t> sum_ns = 0;
+
+	void observe(std::chrono::nanoseconds elapsed)
+	{
+		double seconds = std::chrono::duration<double>(elapsed).count();
+
+		std::size_t bucket = 0;
+		while (bucket < DSS::metrics::LATENCY_BUCKETS.size() && seconds > DSS::metrics::LATENCY_BUCKETS[bucket])
+		{
+			bucket++;
+		}
+
+		bump(buckets[bucket]);
+		bump(sum_ns, std::uint64_t(elapsed.count()));
+	}
+};
+
+struct command_counters_t
+{
+	std::string name = "";
+	std::atomic<std::uint64_t> calls = 0;
+	std::atomic<std::uint64_t> errors = 0;
+	histogram_t latency = {};
+
+	/**
+	 * Published to readers by the head of the list, never modified afterwards
+	 */
+	command_counters_t *next = nullptr;
+};
+
+/**
+ * The counters of one thread
+ */
+struct shard_t
+{
+	std::atomic<std::uint64_t> tasks = 0;
+	std::atomic<std::uint64_t> statements = 0;
+	std::atomic<std::uint64_t> errors = 0;
+	histogram_t task_latency = {};
+
+	/**
+	 * A list only the owning thread prepends to
+	 */
+	std::atomic<command_counters_t *> commands = nullptr;
+
+	/**
+	 * Whether a thread currently writes the shard. Guarded by `g_shards_mutex`.
+	 */
+	bool owned = false;
+
+	~shard_t()
+	{
+		command_counters_t *node = commands.load(std::memory_order_acquire);
+		while (node != nullptr)
+		{
+			command_counters_t *next = node->next;
+			delete node;
+			node = next;
+		}
+	}
+};
+
+/**
+ * Shards are kept once their thread exits, since counters never go back,
+ * and are adopted by the next thread which needs one.
+ */
+std::mutex g_shards_mutex;
+std::vector<std::shared_ptr<shard_t>> g_shards;
+
+/**
+ * The shard of a thread, and its index of commands
+ */
+struct local_t
+{
+	std::shared_ptr<shard_t> shard = nullptr;
+	std::unordered_map<std::string, command_counters_t *> commands = {};
+
+	local_t()
+	{
+		std::lock_guard<std::mutex> lock(g_shards_mutex);
+
+		for (auto &candidate : g_shards)
+		{
+			if (candidate->owned == false)
+			{
+				shard = candidate;
+				break;
+			}
+		}
+
+		if (shard == nullptr)
+		{
+			shard = std::make_shared<shard_t>();
+			g_shards.push_back(shard);
+		}
+		shard->owned = true;
+
+		for (command_counters_t *node = shard->commands.load(std::memory_order_relaxed); node != nullptr; node = node->next)
+		{
+			commands[node->name] = node;
+		}
+	}
+
+	~local_t()
+	{
+		std::lock_guard<std::mutex> lock(g_shards_mutex);
+		shard->owned = false;
+	}
+
+	auto command(const std::string &name) -> command_counters_t &
+	{
+		auto found = commands.find(name);
+		if (found != commands.end())
+		{
+			return *found->second;
+		}
+
+		command_counters_t *node = new command_counters_t();
+		node->name = name;
+		node->next = shard->commands.load(std::memory_order_relaxed);
+		shard->commands.store(node, std::memory_order_release);
+		commands[name] = node;
+
+		return *node;
+	}
+};
+
+auto local() -> local_t &
+{
+	thread_local local_t t_local;
+	return t_local;
+}
+
+/**
+ * Sums of every shard
+ */
+struct totals_t
+{
+	std::uint64_t tasks = 0;
+	std::uint64_t statements = 0;
+	std::uint64_t errors = 0;
+	std::array<std::uint64_t, BUCKET_COUNT> task_buckets = {};
+	std::uint64_t task_sum_ns = 0;
+
+	struct command_t
+	{
+		std::uint64_t calls = 0;
+		std::uint64_t errors = 0;
+		std::array<std::uint64_t, BUCKET_COUNT> buckets = {};
+		std::uint64_t sum_ns = 0;
+	};
+
+	std::map<std::string, command_t> commands = {};
+};
+
+void add_histogram(const histogram_t &from, std::array<std::uint64_t, BUCKET_COUNT> &buckets, std::uint64_t &sum_ns)
+{
+	for (std::size_t i = 0; i < BUCKET_COUNT; i++)
+	{
+		buckets[i] += from.buckets[i].load(std::memory_order_relaxed);
+	}
+	sum_ns += from.sum_ns.load(std::memory_order_relaxed);
+}
+
+auto collect() -> totals_t
+{
+	std::vector<std::shared_ptr<shard_t>> shards = {};
+	{
+		std::lock_guard<std::mutex> lock(g_shards_mutex);
+		shards = g_shards;
+	}
+
+	totals_t res = {};
+
+	for (const auto &shard : shards)
+	{
+		res.tasks += shard->tasks.load(std::memory_order_relaxed);
+		res.statements += shard->statements.load(std::memory_order_relaxed);
+		res.errors += shard->errors.load(std::memory_order_relaxed);
+		add_histogram(shard->task_latency, res.task_buckets, res.task_sum_ns);
+
+		for (command_counters_t *node = shard->commands.load(std::memory_order_acquire); node != nullptr; node = node->next)
+		{
+			totals_t::command_t &command = res.commands[node->name];
+			command.calls += node->calls.load(std::memory_order_relaxed);
+			command.errors += node->errors.load(std::memory_order_relaxed);
+			add_histogram(node->latency, command.buckets, command.sum_ns);
+		}
+	}
+
+	return res;
+}
+
+auto format_value(double value) -> std::string
+{
+	char buffer[32];
+
+	// Counters are written exactly, as long as a double holds them
+	if (value == std::floor(value) && std::fabs(value) < 9007199254740992.0)
+	{
+		std::snprintf(buffer, sizeof(buffer), "%.0f", value);
+	}
+	else
+	{
+		std::snprintf(buffer, sizeof(buffer), "%.9g", value);
+	}
+	return buffer;
+}
+
+auto escape_label(const std::string &value) -> std::string
+{
+	std::string res;
+	res.reserve(value.size());
+
+	for (char c : value)
+	{
+		switch (c)
+		{
+		case '\\':
+			res += "\\\\";
+			break;
+		case '"':
+			res += "\\\"";
+			break;
+		case '\n':
+			res += "\\n";
+			break;
+		default:
+			res += c;
+		}
+	}
+
+	return res;
+}
+
+void write_header(std::string &out, const std::string &name, const std::string &type, const std::string &help)
+{
+	out += "# HELP ";
+	out += name;
+	out += ' ';
+	out += help;
+	out += "\n# TYPE ";
+	out += name;
+	out += ' ';
+	out += type;
+	out += '\n';
+}
+
+void write_sample(std::string &out, const std::string &name, const std::string &labels, double value)
+{
+	out += name;
+	if (labels.empty() == false)
+	{
+		out += '{';
+		out += labels;
+		out += '}';
+	}
+	out += ' ';
+	out += format_value(value);
+	out += '\n';
+}
+
+/**
+ * @param labels Labels of every sample, without the bucket bound
+ */
+void write_histogram(std::string &out, const std::string &name, const std::string &labels, const std::array<std::uint64_t, BUCKET_COUNT> &buckets,
+	std::uint64_t sum_ns)
+{
+	std::string prefix = labels.empty() == true ? "" : labels + ",";
+	std::uint64_t count = 0;
+
+	for (std::size_t i = 0; i < BUCKET_COUNT; i++)
+	{
+		count += buckets[i];
+		std::string bound = i < DSS::metrics::LATENCY_BUCKETS.size() ? format_value(DSS::metrics::LATENCY_BUCKETS[i]) : "+Inf";
+		write_sample(out, name + "_bucket", prefix + "le=\"" + bound + "\"", double(count));
+	}
+
+	write_sample(out, name + "_sum", labels, double(sum_ns) / 1e9);
+	write_sample(out, name + "_count", labels, double(count));
+}
+
+/**
+ * @return The virtual and resident memory of the process, in bytes
+ */
+auto memory_usage() -> std::pair<std::uint64_t, std::uint64_t>
+{
+	std::FILE *file = std::fopen("/proc/self/statm", "r");
+	if (file == nullptr)
+	{
+		return {0, 0};
+	}
+
+	unsigned long long size = 0;
+	unsigned long long resident = 0;
+	int read = std::fscanf(file, "%llu %llu", &size, &resident);
+	std::fclose(file);
+
+	if (read != 2)
+	{
+		return {0, 0};
+	}
+
+	std::uint64_t page = std::uint64_t(sysconf(_SC_PAGESIZE));
+	return {size * page, resident * page};
+}
+
+void send_all(int fd, const std::string &data)
+{
+	std::size_t sent = 0;
+	while (sent < data.size())
+	{
+		ssize_t res = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+		if (res <= 0)
+		{
+			return;
+		}
+		sent += std::size_t(res);
+	}
+}
+
+} // namespace
+
+void DSS::metrics::record_task(std::chrono::nanoseconds elapsed, std::uint64_t statements)
+{
+	shard_t &shard = *local().shard;
+
+	bump(shard.tasks);
+	bump(shard.statements, statements);
+	shard.task_latency.observe(elapsed);
+}
+
+void DSS::metrics::record_error() { bump(local().shard->errors); }
+
+auto DSS::metrics::errors() -> std::uint64_t
+{
+	std::lock_guard<std::mutex> lock(g_shards_mutex);
+
+	std::uint64_t res = 0;
+	for (const auto &shard : g_shards)
+	{
+		res += shard->errors.load(std::memory_order_relaxed);
+	}
+	return res;
+}
+
+void DSS::metrics::record_command(const DSS::command_t &command, bool failed, std::chrono::nanoseconds elapsed)
+{
+	command_counters_t &counters = local().command(command.get_name());
+
+	bump(counters.calls);
+	if (failed == true)
+	{
+		bump(counters.errors);
+	}
+	counters.latency.observe(elapsed);
+}
+
+auto DSS::metrics::render() -> std::string
+{
+	totals_t totals = collect();
+	std::string out;
+
+	write_header(out, "dss_tasks_total", "counter", "Tasks executed.");
+	write_sample(out, "dss_tasks_total", "", double(totals.tasks));
+
+	write_header(out, "dss_statements_total", "counter", "Commands dispatched by executed tasks.");
+	write_sample(out, "dss_statements_total", "", double(totals.statements));
+
+	write_header(out, "dss_errors_total", "counter", "Errors pushed by executors.");
+	write_sample(out, "dss_errors_total", "", double(totals.errors));
+
+	write_header(out, "dss_task_duration_seconds", "histogram", "Wall-clock time of executed tasks.");
+	write_histogram(out, "dss_task_duration_seconds", "", totals.task_buckets, totals.task_sum_ns);
+
+	if (totals.commands.empty() == false)
+	{
+		write_header(out, "dss_command_calls_total", "counter", "Command calls, per command.");
+		for (const auto &[name, command] : totals.commands)
+		{
+			write_sample(out, "dss_command_calls_total", "command=\"" + escape_label(name) + "\"", double(command.calls));
+		}
+
+		write_header(out, "dss_command_errors_total", "counter", "Command calls which failed, per command.");
+		for (const auto &[name, command] : totals.commands)
+		{
+			write_sample(out, "dss_command_errors_total", "command=\"" + escape_label(name) + "\"", double(command.errors));
+		}
+
+		write_header(out, "dss_command_duration_seconds", "histogram", "Wall-clock time of command calls, per command.");
+		for (const auto &[name, command] : totals.commands)
+		{
+			write_histogram(out, "dss_command_duration_seconds", "command=\"" + escape_label(name) + "\"", command.buckets, command.sum_ns);
+		}
+	}
+
+	DSS::log_stats_t log = DSS::logger().stats();
+
+	write_header(out, "dss_log_records_total", "counter", "Log records written.");
+	write_sample(out, "dss_log_records_total", "", double(log.written));
+
+	write_header(out, "dss_log_records_dropped_total", "counter", "Log records dropped, per reason.");
+	write_sample(out, "dss_log_records_dropped_total", "reason=\"full\"", double(log.dropped_full));
+	write_sample(out, "dss_log_records_dropped_total", "reason=\"rate\"", double(log.dropped_rate));
+
+	auto [virtual_bytes, resident_bytes] = memory_usage();
+
+	write_header(out, "process_virtual_memory_bytes", "gauge", "Virtual memory size in bytes.");
+	write_sample(out, "process_virtual_memory_bytes", "", double(virtual_bytes));
+
+	write_header(out, "process_resident_memory_bytes", "gauge", "Resident memory size in bytes.");
+	write_sample(out, "process_resident_memory_bytes", "", double(resident_bytes));
+
+	DSS::page_faults_t faults = DSS::memory::page_faults();
+
+	write_header(out, "dss_page_faults_total", "counter", "Page faults of the process, per kind.");
+	write_sample(out, "dss_page_faults_total", "kind=\"minor\"", double(faults.minor));
+	write_sample(out, "dss_page_faults_total", "kind=\"major\"", double(faults.major));
+
+	write_header(out, "dss_memory_locked_bytes", "gauge", "Memory locked by the process.");
+	write_sample(out, "dss_memory_locked_bytes", "", double(DSS::memory::locked_bytes()));
+
+	write_header(out, "dss_memory_huge_page_bytes", "gauge", "Anonymous memory backed by transparent huge pages.");
+	write_sample(out, "dss_memory_huge_page_bytes", "", double(DSS::memory::huge_page_bytes()));
+
+	return out;
+}
+
+DSS::metrics_exporter_t::~metrics_exporter_t() { stop(); }
+
+void DSS::metrics_exporter_t::watch(DSS::environment_t &env)
+{
+	m_env = &env;
+
+	env.add_post_dispatch_hook([](const DSS::dispatch_t &call) {
+		bool failed = call.status.has_value() == false || call.status.value() != 0;
+		DSS::metrics::record_command(*call.command, failed, call.elapsed);
+	});
+}
+
+auto DSS::metrics_exporter_t::render() -> std::string
+{
+	std::string out = DSS::metrics::render();
+
+	if (m_env == nullptr)
+	{
+		return out;
+	}
+
+	DSS::scheduler_t &scheduler = m_env->get_scheduler();
+
+	write_header(out, "dss_executors", "gauge", "Executors of the environment.");
+	write_sample(out, "dss_executors", "", double(m_env->executor_count()));
+
+	write_header(out, "dss_scheduler_workers", "gauge", "Worker threads of the scheduler.");
+	write_sample(out, "dss_scheduler_workers", "", double(scheduler.worker_count()));
+
+	write_header(out, "dss_scheduler_queue_depth", "gauge", "Submitted tasks not yet complete.");
+	write_sample(out, "dss_scheduler_queue_depth", "", double(scheduler.queue_depth()));
+
+	write_header(out, "dss_scheduler_deadline_misses_total", "counter", "Submitted tasks completed after their deadline.");
+	write_sample(out, "dss_scheduler_deadline_misses_total", "", double(scheduler.total_deadline_misses()));
+
+	write_header(out, "dss_work_pool_queue_depth", "gauge", "Independent tasks not yet taken by a worker.");
+	write_sample(out, "dss_work_pool_queue_depth", "", double(m_env->get_work_pool().queued()));
+
+	return out;
+}
+
+auto DSS::metrics_exporter_t::listen_tcp(std::uint16_t port) -> std::optional<std::uint16_t>
+{
+	if (m_thread.joinable() == true)
+	{
+		return std::nullopt;
+	}
+
+	int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+	{
+		return std::nullopt;
+	}
+
+	int reuse = 1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+	sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_port = htons(port);
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	socklen_t length = sizeof(address);
+	if (bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 ||
+		getsockname(fd, reinterpret_cast<sockaddr *>(&address), &length) != 0 || serve(fd) == false)
+	{
+		close(fd);
+		return std::nullopt;
+	}
+
+	return ntohs(address.sin_port);
+}
+
+auto DSS::metrics_exporter_t::listen_unix(const std::string &path) -> bool
+{
+	sockaddr_un address = {};
+	if (m_thread.joinable() == true || path.size() >= sizeof(address.sun_path))
+	{
+		return false;
+	}
+	address.sun_family = AF_UNIX;
+	std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	unlink(path.c_str());
+	if (bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0)
+	{
+		close(fd);
+		return false;
+	}
+	if (serve(fd) == false)
+	{
+		close(fd);
+		unlink(path.c_str());
+		return false;
+	}
+
+	m_unix_path = path;
+	return true;
+}
+
+auto DSS::metrics_exporter_t::serve(int fd) -> bool
+{
+	if (listen(fd, 16) != 0)
+	{
+		return false;
+	}
+
+	m_wake_fd = eventfd(0, EFD_CLOEXEC);
+	if (m_wake_fd < 0)
+	{
+		return false;
+	}
+
+	m_listen_fd = fd;
+	m_thread = std::thread(&DSS::metrics_exporter_t::serve_loop, this);
+
+	return true;
+}
+
+void DSS::metrics_exporter_t::stop()
+{
+	if (m_thread.joinable() == false)
+	{
+		return;
+	}
+
+	std::uint64_t wake = 1;
+	(void)write(m_wake_fd, &wake, sizeof(wake));
+	m_thread.join();
+
+	close(m_listen_fd);
+	close(m_wake_fd);
+	m_listen_fd = -1;
+	m_wake_fd = -1;
+
+	if (m_unix_path.empty() == false)
+	{
+		unlink(m_unix_path.c_str());
+		m_unix_path.clear();
+	}
+}
+
+void DSS::metrics_exporter_t::serve_loop()
+{
+	while (true)
+	{
+		pollfd fds[2] = {{m_listen_fd, POLLIN, 0}, {m_wake_fd, POLLIN, 0}};
+
+		if (poll(fds, 2, -1) < 0)
+		{
+			continue; // Interrupted
+		}
+		if ((fds[1].revents & POLLIN) != 0)
+		{
+			return;
+		}
+		if ((fds[0].revents & POLLIN) == 0)
+		{
+			continue;
+		}
+
+		int fd = accept4(m_listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+		if (fd < 0)
+		{
+			continue;
+		}
+
+		answer(fd);
+		close(fd);
+	}
+}
+
+void DSS::metrics_exporter_t::answer(int fd)
+{
+	// A stalled client must not stall the exporter
+	timeval timeout = {1, 0};
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+	std::string request;
+	char buffer[1024];
+
+	while (request.find("\r\n\r\n") == std::string::npos && request.size() < MAX_REQUEST)
+	{
+		ssize_t res = recv(fd, buffer, sizeof(buffer), 0);
+		if (res <= 0)
+		{
+			return;
+		}
+		request.append(buffer, std::size_t(res));
+	}
+
+	std::string line = request.substr(0, request.find("\r\n"));
+	bool found = line.starts_with("GET /metrics ") == true || line.starts_with("GET /metrics?") == true;
+
+	std::string body = found == true ? render() : "not found\n";
+	std::string status = found == true ? "200 OK" : "404 Not Found";
+	std::string type = found == true ? "text/plain; version=0.0.4; charset=utf-8" : "text/plain";
+
+	send_all(fd, "HTTP/1.1 " + status + "\r\nContent-Type: " + type + "\r\nContent-Length: " + std::to_string(body.size()) +
+					 "\r\nConnection: close\r\n\r\n" + body);
+}
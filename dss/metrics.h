@@ -0,0 +1,135 @@
+/**
+ * This file contains the metrics of DSS, and an exporter which serves
+ * them in the Prometheus text exposition format.
+ *
+ * Counters are kept per thread: every thread increments its own shard
+ * without locks or atomic read-modify-writes, and shards are only summed
+ * when the metrics are scraped. Task, statement and error counters are
+ * always recorded; per-command counters are recorded once an exporter
+ * watches the environment (through dispatch hooks).
+ */
+
+#ifndef H_METRICS
+#define H_METRICS
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <thread>
+
+#include "runtime.h"
+
+namespace DSS
+{
+
+namespace metrics
+{
+
+/**
+ * Upper bounds of the latency histograms, in seconds
+ */
+const std::array<double, 12> LATENCY_BUCKETS = {0.000001, 0.000005, 0.00001, 0.00005, 0.0001, 0.0005, 0.001, 0.005, 0.01, 0.05, 0.1, 1.0};
+
+/**
+ * Records a completed task on the shard of the calling thread
+ *
+ * @param elapsed Wall-clock time of the task
+ * @param statements Commands dispatched by the task
+ */
+void record_task(std::chrono::nanoseconds elapsed, std::uint64_t statements);
+
+/**
+ * Records an error pushed by the calling thread
+ */
+void record_error();
+
+/**
+ * @return The errors pushed so far, by every thread of the process
+ */
+auto errors() -> std::uint64_t;
+
+/**
+ * Records a command call on the shard of the calling thread
+ *
+ * @param failed Whether the call returned a non-zero status, or could not be made
+ */
+void record_command(const command_t &command, bool failed, std::chrono::nanoseconds elapsed);
+
+/**
+ * @return Every metric, in the Prometheus text exposition format
+ * (process-wide counters only, see `metrics_exporter_t::render`)
+ */
+auto render() -> std::string;
+
+} // namespace metrics
+
+class metrics_exporter_t
+{
+public:
+	metrics_exporter_t() = default;
+
+	/**
+	 * Stops listening
+	 */
+	~metrics_exporter_t();
+
+	metrics_exporter_t(const metrics_exporter_t &) = delete;
+	metrics_exporter_t &operator=(const metrics_exporter_t &) = delete;
+
+	/**
+	 * Records per-command counters of the environment, and adds its
+	 * gauges (executors, queue depths) to the exported metrics.
+	 *
+	 * @note The environment must outlive the exporter. Like every
+	 * dispatch hook, this should be done while no task is running.
+	 */
+	void watch(environment_t &env);
+
+	/**
+	 * Serves `GET /metrics` over HTTP on 127.0.0.1. An exporter
+	 * listens on one socket at a time.
+	 *
+	 * @param port The port to listen on, or 0 for any free port
+	 *
+	 * @return The port listened on, or std::nullopt on failure
+	 */
+	auto listen_tcp(std::uint16_t port) -> std::optional<std::uint16_t>;
+
+	/**
+	 * Serves `GET /metrics` over HTTP on a Unix socket
+	 * (`curl --unix-socket <path> http://localhost/metrics`).
+	 * An existing socket at `path` is replaced.
+	 */
+	auto listen_unix(const std::string &path) -> bool;
+
+	/**
+	 * Stops serving, once the current request (if any) is answered
+	 */
+	void stop();
+
+	/**
+	 * @return Every metric, in the Prometheus text exposition format
+	 */
+	auto render() -> std::string;
+
+private:
+	environment_t *m_env = nullptr;
+
+	int m_listen_fd = -1;
+	int m_wake_fd = -1;
+	std::string m_unix_path = "";
+	std::thread m_thread;
+
+	auto serve(int fd) -> bool;
+
+	void serve_loop();
+
+	void answer(int fd);
+};
+
+} // namespace DSS
+
+#endif // H_METRICS
@@ -0,0 +1,456 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <sstream>
+
+#include <pthread.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "metrics.h"
+#include "process_pool.h"
+
+namespace
+{
+
+enum slot_state_t : std::uint32_t
+{
+	FREE,
+	QUEUED,
+	RUNNING,
+	DONE,
+	FAILED,
+};
+
+/**
+ * Start of the shared job table. The slots follow, each
+ * followed by `slot_size` bytes of script and of output.
+ */
+struct shared_header_t
+{
+	pthread_mutex_t mutex;
+
+	/**
+	 * Signalled when a job is queued, or the pool stops
+	 */
+	pthread_cond_t work;
+
+	/**
+	 * Signalled when a job completes
+	 */
+	pthread_cond_t done;
+
+	std::uint32_t stopping;
+	DSS::job_id_t next_job;
+};
+
+struct shared_slot_t
+{
+	std::uint32_t state;
+	pid_t pid;
+	DSS::job_id_t job;
+	DSS::return_type_t status;
+	std::uint32_t script_size;
+	std::uint32_t output_size;
+	std::uint32_t truncated;
+};
+
+auto slot_stride(std::size_t slot_size) -> std::size_t
+{
+	std::size_t res = sizeof(shared_slot_t) + 2 * slot_size;
+	return (res + alignof(shared_slot_t) - 1) / alignof(shared_slot_t) * alignof(shared_slot_t);
+}
+
+auto header_of(void *shared) -> shared_header_t * { return static_cast<shared_header_t *>(shared); }
+
+auto slot_of(void *shared, std::size_t index, std::size_t slot_size) -> shared_slot_t *
+{
+	char *base = static_cast<char *>(shared) + sizeof(shared_header_t);
+	return reinterpret_cast<shared_slot_t *>(base + index * slot_stride(slot_size));
+}
+
+auto script_of(shared_slot_t *slot) -> char * { return reinterpret_cast<char *>(slot + 1); }
+
+auto output_of(shared_slot_t *slot, std::size_t slot_size) -> char * { return script_of(slot) + slot_size; }
+
+/**
+ * Locks the shared mutex. A worker may die while holding it,
+ * in which case the lock is recovered.
+ */
+void lock_shared(pthread_mutex_t *mutex)
+{
+	if (pthread_mutex_lock(mutex) == EOWNERDEAD)
+	{
+		pthread_mutex_consistent(mutex);
+	}
+}
+
+/**
+ * Delays before retrying a worker which could not be forked
+ */
+const std::chrono::milliseconds RETRY_BACKOFF_MIN = std::chrono::milliseconds(10);
+const std::chrono::milliseconds RETRY_BACKOFF_MAX = std::chrono::milliseconds(1000);
+
+auto deadline_after(std::chrono::milliseconds timeout) -> timespec
+{
+	timespec res = {};
+	clock_gettime(CLOCK_MONOTONIC, &res);
+
+	std::int64_t ms = std::min<std::int64_t>(timeout.count(), 50);
+	res.tv_sec += ms / 1000;
+	res.tv_nsec += (ms % 1000) * 1000000;
+	if (res.tv_nsec >= 1000000000)
+	{
+		res.tv_sec++;
+		res.tv_nsec -= 1000000000;
+	}
+
+	return res;
+}
+
+} // namespace
+
+DSS::process_pool_t::process_pool_t(std::shared_ptr<DSS::executor_t> prototype, DSS::process_pool_options_t options)
+{
+	m_prototype = prototype;
+	m_options = options;
+}
+
+DSS::process_pool_t::~process_pool_t() { stop(); }
+
+auto DSS::process_pool_t::start() -> bool
+{
+	if (m_shared != nullptr || m_prototype == nullptr || m_options.workers == 0 || m_options.slots == 0)
+	{
+		return false;
+	}
+
+	m_shared_size = sizeof(shared_header_t) + m_options.slots * slot_stride(m_options.slot_size);
+	m_shared = mmap(nullptr, m_shared_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (m_shared == MAP_FAILED)
+	{
+		m_shared = nullptr;
+		return false;
+	}
+
+	shared_header_t *header = header_of(m_shared);
+
+	pthread_mutexattr_t mutex_attr;
+	pthread_mutexattr_init(&mutex_attr);
+	pthread_mutexattr_setpshared(&mutex_attr, PTHREAD_PROCESS_SHARED);
+	pthread_mutexattr_setrobust(&mutex_attr, PTHREAD_MUTEX_ROBUST);
+	pthread_mutex_init(&header->mutex, &mutex_attr);
+	pthread_mutexattr_destroy(&mutex_attr);
+
+	pthread_condattr_t cond_attr;
+	pthread_condattr_init(&cond_attr);
+	pthread_condattr_setpshared(&cond_attr, PTHREAD_PROCESS_SHARED);
+	pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&header->work, &cond_attr);
+	pthread_cond_init(&header->done, &cond_attr);
+	pthread_condattr_destroy(&cond_attr);
+
+	header->stopping = 0;
+	header->next_job = 1;
+
+	// Anonymous mappings are zeroed, so every slot starts FREE
+	m_pids.assign(m_options.workers, -1);
+	m_retries.assign(m_options.workers, retry_t());
+	for (std::size_t i = 0; i < m_options.workers; i++)
+	{
+		respawn(i);
+	}
+
+	return true;
+}
+
+void DSS::process_pool_t::stop()
+{
+	if (m_shared == nullptr)
+	{
+		return;
+	}
+
+	shared_header_t *header = header_of(m_shared);
+
+	lock_shared(&header->mutex);
+	header->stopping = 1;
+	pthread_cond_broadcast(&header->work);
+	pthread_mutex_unlock(&header->mutex);
+
+	for (pid_t pid : m_pids)
+	{
+		if (pid > 0)
+		{
+			waitpid(pid, nullptr, 0);
+		}
+	}
+	m_pids.clear();
+	m_retries.clear();
+
+	munmap(m_shared, m_shared_size);
+	m_shared = nullptr;
+}
+
+auto DSS::process_pool_t::spawn() -> pid_t
+{
+	std::cout.flush();
+
+	pid_t pid = ::fork();
+	if (pid == 0)
+	{
+		worker_main();
+	}
+
+	return pid;
+}
+
+auto DSS::process_pool_t::respawn(std::size_t index) -> bool
+{
+	m_pids[index] = spawn();
+
+	retry_t &retry = m_retries[index];
+	if (m_pids[index] > 0)
+	{
+		retry.backoff = std::chrono::milliseconds(0);
+		return true;
+	}
+
+	// Out of processes or memory, which may not last
+	m_pids[index] = -1;
+	retry.backoff = std::clamp(retry.backoff * 2, RETRY_BACKOFF_MIN, RETRY_BACKOFF_MAX);
+	retry.at = std::chrono::steady_clock::now() + retry.backoff;
+	return false;
+}
+
+void DSS::process_pool_t::worker_main()
+{
+	shared_header_t *header = header_of(m_shared);
+
+	// Output is captured per job, and handed back through the job table
+	std::stringstream captured;
+	std::streambuf *original = std::cout.rdbuf(captured.rdbuf());
+
+	lock_shared(&header->mutex);
+
+	while (header->stopping == 0)
+	{
+		shared_slot_t *slot = nullptr;
+
+		for (std::size_t i = 0; i < m_options.slots; i++)
+		{
+			shared_slot_t *candidate = slot_of(m_shared, i, m_options.slot_size);
+			if (candidate->state != QUEUED)
+			{
+				continue;
+			}
+
+			// Oldest job first
+			if (slot == nullptr || candidate->job < slot->job)
+			{
+				slot = candidate;
+			}
+		}
+
+		if (slot == nullptr)
+		{
+			if (pthread_cond_wait(&header->work, &header->mutex) == EOWNERDEAD)
+			{
+				pthread_mutex_consistent(&header->mutex);
+			}
+			continue;
+		}
+
+		slot->state = RUNNING;
+		slot->pid = getpid();
+		std::string script = std::string(script_of(slot), slot->script_size);
+		pthread_mutex_unlock(&header->mutex);
+
+		captured.str("");
+		std::uint64_t errors = DSS::metrics::errors();
+		std::shared_ptr<DSS::executor_t> executor = m_prototype->fork();
+		executor->exec(std::move(script));
+		std::cout.flush();
+		std::string output = captured.str();
+
+		lock_shared(&header->mutex);
+		slot->status = DSS::metrics::errors() > errors ? 1 : 0;
+		slot->truncated = output.size() > m_options.slot_size ? 1 : 0;
+		slot->output_size = std::uint32_t(std::min(output.size(), m_options.slot_size));
+		std::memcpy(output_of(slot, m_options.slot_size), output.data(), slot->output_size);
+		slot->state = DONE;
+		pthread_cond_broadcast(&header->done);
+	}
+
+	pthread_mutex_unlock(&header->mutex);
+	std::cout.rdbuf(original);
+
+	// Destructors belong to the parent
+	_exit(0);
+}
+
+auto DSS::process_pool_t::submit(const std::string &script) -> std::optional<DSS::job_id_t>
+{
+	if (m_shared == nullptr || script.size() > m_options.slot_size)
+	{
+		return std::nullopt;
+	}
+
+	shared_header_t *header = header_of(m_shared);
+	std::optional<DSS::job_id_t> res = std::nullopt;
+
+	lock_shared(&header->mutex);
+	for (std::size_t i = 0; i < m_options.slots; i++)
+	{
+		shared_slot_t *slot = slot_of(m_shared, i, m_options.slot_size);
+		if (slot->state != FREE)
+		{
+			continue;
+		}
+
+		slot->job = header->next_job++;
+		slot->pid = 0;
+		slot->status = 0;
+		slot->output_size = 0;
+		slot->truncated = 0;
+		slot->script_size = std::uint32_t(script.size());
+		std::memcpy(script_of(slot), script.data(), script.size());
+		slot->state = QUEUED;
+
+		res = slot->job;
+		pthread_cond_signal(&header->work);
+		break;
+	}
+	pthread_mutex_unlock(&header->mutex);
+
+	return res;
+}
+
+auto DSS::process_pool_t::collect(DSS::job_id_t job, std::chrono::milliseconds timeout) -> std::optional<DSS::process_result_t>
+{
+	if (m_shared == nullptr)
+	{
+		return std::nullopt;
+	}
+
+	shared_header_t *header = header_of(m_shared);
+	std::chrono::steady_clock::time_point give_up = std::chrono::steady_clock::time_point::max();
+	if (timeout != std::chrono::milliseconds::max())
+	{
+		give_up = std::chrono::steady_clock::now() + timeout;
+	}
+
+	while (true)
+	{
+		// Workers which died would never complete their job
+		supervise();
+
+		lock_shared(&header->mutex);
+
+		shared_slot_t *slot = nullptr;
+		for (std::size_t i = 0; i < m_options.slots; i++)
+		{
+			shared_slot_t *candidate = slot_of(m_shared, i, m_options.slot_size);
+			if (candidate->state != FREE && candidate->job == job)
+			{
+				slot = candidate;
+				break;
+			}
+		}
+
+		if (slot == nullptr)
+		{
+			pthread_mutex_unlock(&header->mutex);
+			return std::nullopt;
+		}
+
+		if (slot->state == DONE || slot->state == FAILED)
+		{
+			DSS::process_result_t res = {};
+			res.status = slot->status;
+			res.crashed = slot->state == FAILED;
+			res.output = std::string(output_of(slot, m_options.slot_size), slot->output_size);
+			res.truncated = slot->truncated != 0;
+			slot->state = FREE;
+			pthread_mutex_unlock(&header->mutex);
+
+			return res;
+		}
+
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if (now >= give_up)
+		{
+			pthread_mutex_unlock(&header->mutex);
+			return std::nullopt;
+		}
+
+		// Wake up periodically to supervise
+		std::chrono::milliseconds remaining = std::chrono::duration_cast<std::chrono::milliseconds>(give_up - now);
+		timespec until = deadline_after(remaining);
+		if (pthread_cond_timedwait(&header->done, &header->mutex, &until) == EOWNERDEAD)
+		{
+			pthread_mutex_consistent(&header->mutex);
+		}
+		pthread_mutex_unlock(&header->mutex);
+	}
+}
+
+void DSS::process_pool_t::supervise()
+{
+	if (m_shared == nullptr)
+	{
+		return;
+	}
+
+	shared_header_t *header = header_of(m_shared);
+
+	for (std::size_t index = 0; index < m_pids.size(); index++)
+	{
+		pid_t pid = m_pids[index];
+
+		// A worker which could not be forked (waiting on -1 would reap any child)
+		if (pid < 0)
+		{
+			if (header->stopping == 0 && std::chrono::steady_clock::now() >= m_retries[index].at)
+			{
+				respawn(index);
+			}
+			continue;
+		}
+
+		int wstatus = 0;
+		if (waitpid(pid, &wstatus, WNOHANG) != pid)
+		{
+			continue;
+		}
+
+		lock_shared(&header->mutex);
+		for (std::size_t i = 0; i < m_options.slots; i++)
+		{
+			shared_slot_t *slot = slot_of(m_shared, i, m_options.slot_size);
+			if (slot->state != RUNNING || slot->pid != pid)
+			{
+				continue;
+			}
+
+			slot->state = FAILED;
+			slot->status = WIFSIGNALED(wstatus) ? DSS::return_type_t(WTERMSIG(wstatus)) : DSS::return_type_t(WEXITSTATUS(wstatus));
+		}
+		bool stopping = header->stopping != 0;
+		pthread_mutex_unlock(&header->mutex);
+
+		if (stopping == true)
+		{
+			continue;
+		}
+
+		if (respawn(index) == true)
+		{
+			m_respawned++;
+		}
+	}
+}
@@ -0,0 +1,180 @@
+/**
+ * This file contains the pre-forked worker process pool.
+ *
+ * The parent builds an executor (and therefore its environment and
+ * command definers) once, then forks worker processes which share
+ * those pages copy-on-write. Scripts are dispatched to the workers,
+ * and results are collected, through a shared-memory job table.
+ *
+ * Grafted commands which are not thread-safe may run in parallel
+ * this way, and a crashing command only takes down its own worker,
+ * which is respawned.
+ */
+
+#ifndef H_PROCESS_POOL
+#define H_PROCESS_POOL
+
+#include <sys/types.h>
+
+#include "runtime.h"
+
+namespace DSS
+{
+
+typedef std::uint64_t job_id_t;
+
+struct process_pool_options_t
+{
+	/**
+	 * The amount of worker processes
+	 */
+	std::size_t workers = 2;
+
+	/**
+	 * The amount of jobs which may be queued or uncollected at once
+	 */
+	std::size_t slots = 64;
+
+	/**
+	 * The maximum size of a script, and of the output captured from it
+	 */
+	std::size_t slot_size = 64 * 1024;
+};
+
+struct process_result_t
+{
+	/**
+	 * The signal (or exit status) of the worker if it `crashed`. Otherwise
+	 * 1 if the script pushed any error, and 0 if it did not.
+	 */
+	return_type_t status = 0;
+
+	/**
+	 * Whether the worker died while executing the script
+	 */
+	bool crashed = false;
+
+	/**
+	 * Everything the script wrote to stdout (truncated to the slot size)
+	 */
+	std::string output = "";
+
+	/**
+	 * Whether the script wrote more than the slot size, which was lost
+	 */
+	bool truncated = false;
+};
+
+class process_pool_t
+{
+public:
+	/**
+	 * @param prototype The executor every job is run on. Each job runs
+	 * in a fresh fork (see `executor_t::fork`) of the prototype, as it
+	 * was when the pool was started.
+	 */
+	process_pool_t(std::shared_ptr<executor_t> prototype, process_pool_options_t options = process_pool_options_t());
+
+	/**
+	 * Stops the pool, if it is running
+	 */
+	~process_pool_t();
+
+	process_pool_t(const process_pool_t &) = delete;
+	process_pool_t &operator=(const process_pool_t &) = delete;
+
+	/**
+	 * Maps the shared job table and forks the workers.
+	 *
+	 * @note Forking only duplicates the calling thread. Start the pool
+	 * before any other threads (such as `environment_t::start_workers`).
+	 *
+	 * @return false if the shared memory could not be mapped
+	 */
+	auto start() -> bool;
+
+	/**
+	 * Asks every worker to exit once idle, and waits for them.
+	 */
+	void stop();
+
+	/**
+	 * Queues a script for any worker.
+	 *
+	 * @return The id of the job, or std::nullopt if the script is too
+	 * large or every slot is in use
+	 */
+	auto submit(const std::string &script) -> std::optional<job_id_t>;
+
+	/**
+	 * Waits for a job to complete and releases its slot.
+	 *
+	 * @param timeout The maximum time to wait
+	 *
+	 * @return The result, or std::nullopt if the job is unknown
+	 * or did not complete in time
+	 */
+	auto collect(job_id_t job, std::chrono::milliseconds timeout = std::chrono::milliseconds::max()) -> std::optional<process_result_t>;
+
+	/**
+	 * Reaps workers which have died. Jobs they were running fail,
+	 * and the workers are replaced. This is done automatically
+	 * while collecting.
+	 */
+	void supervise();
+
+	/**
+	 * @return The amount of workers which were replaced after dying
+	 */
+	auto respawned() -> std::uint64_t { return m_respawned; }
+
+	/**
+	 * @return The process of every worker. A worker which could not be
+	 * forked is -1 until a retry succeeds (see `supervise`).
+	 */
+	auto worker_pids() -> const std::vector<pid_t> & { return m_pids; }
+
+private:
+	std::shared_ptr<executor_t> m_prototype;
+	process_pool_options_t m_options;
+
+	/**
+	 * The shared job table, see process_pool.cpp
+	 */
+	void *m_shared = nullptr;
+	std::size_t m_shared_size = 0;
+
+	std::vector<pid_t> m_pids;
+
+	/**
+	 * When to retry forking a worker which could not be forked, and
+	 * the delay before the retry after that. Indexed like `m_pids`.
+	 */
+	struct retry_t
+	{
+		std::chrono::steady_clock::time_point at = {};
+		std::chrono::milliseconds backoff = std::chrono::milliseconds(0);
+	};
+	std::vector<retry_t> m_retries;
+
+	std::uint64_t m_respawned = 0;
+
+	auto spawn() -> pid_t;
+
+	/**
+	 * Forks the worker `index`. On failure, the worker is left at -1
+	 * and retried with an exponential backoff.
+	 *
+	 * @return false if the worker could not be forked
+	 */
+	auto respawn(std::size_t index) -> bool;
+
+	/**
+	 * The loop of a worker process. Never returns.
+	 */
+	[[noreturn]] void worker_main();
+};
+
+} // namespace DSS
+
+#endif // H_PROCESS_POOL
@@ -9,77 +9,290 @@
  *
  */
 #include <any>
+#include <cstring>
 #include <iostream>
 #include <string>
 #include <sstream>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include "dss_utils.h"
 #include "runtime.h"
 #include "dss_lang.h"
 #include "init.h"
+#include "ir.h"
+#include "scheduler.h"
+#include "script_store.h"
+#include "work_pool.h"
+#include "journal.h"
+#include "log.h"
+#include "metrics.h"
+#include "snapshot.h"
+
+namespace
+{
+
+/**
+ * A file mapped read-only for the lifetime of the buffer
+ */
+class mapped_script_t : public DSS::script_buffer_t
+{
+public:
+	mapped_script_t(const char *data, std::size_t size)
+	{
+		m_data = data;
+		m_size = size;
+	}
+
+	~mapped_script_t() override
+	{
+		if (m_size > 0)
+		{
+			munmap(const_cast<char *>(m_data), m_size);
+		}
+	}
+
+	auto view() const -> std::string_view override { return std::string_view(m_data, m_size); }
+
+private:
+	const char *m_data = nullptr;
+	std::size_t m_size = 0;
+};
+
+} // namespace
+
+auto DSS::map_script(const std::string &path) -> std::shared_ptr<const DSS::script_buffer_t>
+{
+	int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+	{
+		return nullptr;
+	}
+
+	struct stat info = {};
+	if (fstat(fd, &info) != 0 || S_ISREG(info.st_mode) == false)
+	{
+		close(fd);
+		return nullptr;
+	}
+
+	std::size_t size = std::size_t(info.st_size);
+	void *data = nullptr;
+
+	// Empty files cannot be mapped
+	if (size > 0)
+	{
+		data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+	close(fd);
+
+	if (data == MAP_FAILED)
+	{
+		return nullptr;
+	}
+
+	return std::make_shared<mapped_script_t>(static_cast<const char *>(data), size);
+}
+
+auto DSS::next_var_serial() -> std::uint64_t
+{
+	static std::atomic<std::uint64_t> s_serial = 0;
+	return s_serial.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+namespace
+{
+
+/**
+ * Where errors of the calling thread are held, while it runs an independent task
+ */
+thread_local DSS::held_output_t *t_held = nullptr;
+
+/**
+ * The executor running a task on the calling thread
+ */
+thread_local DSS::run_id_t t_run_id = DSS::NO_RUN_ID;
+
+} // namespace
 
 void DSS::push_error(std::string what, int line)
 {
-	std::cout << std::endl << "error: a critical exception occurred";
+	DSS::push_error(t_run_id, std::move(what), line);
+}
+
+void DSS::push_error(DSS::run_id_t run_id, std::string what, int line)
+{
+	(void)run_id; // Only read by the probe, when tracing is compiled in
+	DSS_TRACE_ERROR_PUSH(run_id, what.c_str(), line);
+	DSS::metrics::record_error();
+
+	if (t_held != nullptr)
+	{
+		t_held->push_error(std::move(what), line);
+		return;
+	}
 
-	if (line > -1)
+	DSS::logger().push(DSS::log_level_t::ERROR, std::move(what), line);
+}
+
+void DSS::held_output_t::take_output()
+{
+	std::string text = m_output.str();
+	if (text.empty() == false)
 	{
-		std::cout << " on line " << line + 1;
+		m_records.push_back({false, -1, std::move(text)});
+		m_output.str("");
 	}
+}
 
-	std::cout << std::endl;
-	std::cout << what << std::endl;
+void DSS::held_output_t::push_error(std::string what, int line)
+{
+	take_output();
+	m_records.push_back({true, line, std::move(what)});
+}
+
+void DSS::held_output_t::replay(std::ostream &output, DSS::held_output_t *errors)
+{
+	take_output();
+
+	for (auto &record : m_records)
+	{
+		if (record.error == false)
+		{
+			output << record.text;
+		}
+		else if (errors != nullptr)
+		{
+			errors->push_error(std::move(record.text), record.line);
+		}
+		else
+		{
+			DSS::logger().push(DSS::log_level_t::ERROR, std::move(record.text), record.line);
+		}
+	}
+
+	m_records.clear();
 }
 
 void DSS::executor_t::find_and_push_error(std::string command, int code, int line)
 {
 	try
 	{
-		DSS::err_codes_t found = m_lookup_error.at(command);
+		const DSS::err_codes_t &found = m_lookup_error->at(command);
 
-		std::string error = found.at(code);
+		const std::string &error = found.at(code);
 
-		DSS::push_error(error, line);
+		DSS::push_error(m_id, error, line);
 	}
 	catch (std::out_of_range &_e)
 	{
-		DSS::push_error(DSS::err::UNKNOWN, line);
+		DSS::push_error(m_id, DSS::err::UNKNOWN, line);
 		return;
 	}
 }
 
-void DSS::executor_t::direct_exec(DSS::strvec_t statements)
+void DSS::executor_t::direct_exec(const DSS::strvec_t &statements, bool control_flow)
 {
-	int line = -1;
+	DSS::ir::program_t program = {};
 
-	for (auto statement : statements)
+	if (DSS::ir::compile(statements, m_loaded_commands, control_flow, program) == false)
 	{
-		line++;
-		DSS::strvec_t parsed = dss_utils::string_split(statement, DSS::key::TOKEN_DELIM);
+		return;
+	}
 
-		// No command
-		if (parsed.size() == 0)
+	run_program(program);
+}
+
+void DSS::executor_t::run_program(const DSS::ir::program_t &program)
+{
+	std::vector<std::int64_t> counters(program.counter_slots, 0);
+	std::size_t pc = 0;
+
+	while (pc < program.code.size())
+	{
+		const DSS::ir::instr_t &instr = program.code[pc];
+		pc++;
+
+		switch (instr.op)
+		{
+		case DSS::ir::op_t::JUMP:
 		{
+			pc = instr.target;
 			continue;
 		}
+		case DSS::ir::op_t::BRANCH:
+		{
+			std::optional<bool> res = DSS::ir::evaluate(instr.cond, m_exec_vars);
 
-		DSS::delegate_return_t res = {};
+			if (res.has_value() == false)
+			{
+				DSS::push_error(m_id, DSS::ir::err::UNDEFINED_VAR, instr.line);
+				return;
+			}
 
-		for (auto command : m_loaded_commands)
+			if (res.value() == false)
+			{
+				pc = instr.target;
+			}
+			continue;
+		}
+		case DSS::ir::op_t::REPEAT_INIT:
 		{
-			DSS::delegate_return_t opt_res = command.attempt_parse_and_exec(parsed, line);
+			std::optional<std::int64_t> count = DSS::ir::resolve_int(instr.count, m_exec_vars);
+
+			if (count.has_value() == false)
+			{
+				DSS::push_error(m_id, DSS::ir::err::BAD_COUNT, instr.line);
+				return;
+			}
 
-			if (opt_res.size() == 0)
+			counters[instr.slot] = count.value();
+			continue;
+		}
+		case DSS::ir::op_t::REPEAT_STEP:
+		{
+			if (counters[instr.slot] <= 0)
 			{
-				continue; // Failed to parse
+				pc = instr.target;
+				continue;
 			}
 
-			res = opt_res;
+			counters[instr.slot]--;
+			continue;
 		}
+		case DSS::ir::op_t::CALL:
+			break;
+		}
+
+		// Handlers may define commands, which leaves the deque's elements in place
+		const DSS::command_t &command = m_loaded_commands[instr.command];
+		DSS::delegate_return_t res = {};
+		m_cpu_usage.statements++;
+		DSS_TRACE_COMMAND_DISPATCH(m_id, instr.keyword.c_str(), instr.line);
+
+		if (m_dispatch_hooks != nullptr)
+		{
+			res = hooked_exec(command, instr.args, instr.line);
+		}
+		else if (m_handler_accounting == true)
+		{
+			std::chrono::nanoseconds start = dss_utils::thread_cpu_now();
+			res = command.exec(instr.args, instr.line);
+			m_cpu_usage.handler_time += dss_utils::thread_cpu_now() - start;
+		}
+		else
+		{
+			res = command.exec(instr.args, instr.line);
+		}
+
+		DSS_TRACE_COMMAND_RETURN(m_id, instr.keyword.c_str(), res.size() == 0 ? -1 : int(res[0]));
 
 		if (res.size() == 0)
 		{
-			continue; // Command does not exist
+			continue; // Failed to parse
 		}
 
 		// Successful execution
@@ -88,14 +301,63 @@ void DSS::executor_t::direct_exec(DSS::strvec_t statements)
 			continue;
 		}
 
-		// The first element of parsed is the keyword, and the first element of res is the returned value
-		find_and_push_error(parsed[0], res[0], line);
+		find_and_push_error(instr.keyword, res[0], instr.line);
+	}
+}
+
+auto DSS::executor_t::hooked_exec(const DSS::command_t &command, const DSS::func_args_t &args, std::int64_t line) -> DSS::delegate_return_t
+{
+	DSS::dispatch_t call = {};
+	call.run_id = m_id;
+	call.executor = this;
+	call.command = &command;
+	call.args = args;
+	call.line = line;
+
+	DSS::delegate_return_t res = {};
+	bool injected = false;
+
+	for (const auto &hook : m_dispatch_hooks->pre)
+	{
+		std::optional<DSS::return_type_t> status = hook(call);
+		if (status.has_value() == true)
+		{
+			res = {status.value()};
+			injected = true;
+			break;
+		}
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	if (injected == false && m_handler_accounting == true)
+	{
+		std::chrono::nanoseconds cpu_start = dss_utils::thread_cpu_now();
+		res = command.exec(args, line);
+		m_cpu_usage.handler_time += dss_utils::thread_cpu_now() - cpu_start;
+	}
+	else if (injected == false)
+	{
+		res = command.exec(args, line);
+	}
+
+	call.elapsed = std::chrono::steady_clock::now() - start;
+	if (res.size() > 0)
+	{
+		call.status = res[0];
 	}
+
+	for (const auto &hook : m_dispatch_hooks->post)
+	{
+		hook(call);
+	}
+
+	return res;
 }
 
 void DSS::executor_t::auto_preprocessors()
 {
-	std::shared_ptr<DSS::var_t<std::any>> auto_preprocessor_var = m_exec_vars.get_or_add_var(DSS::AUTO_PREPROCESSOR_VAR);
+	std::shared_ptr<const DSS::var_t<std::any>> auto_preprocessor_var = m_exec_vars.get_or_add_var(DSS::AUTO_PREPROCESSOR_VAR);
 	if (auto_preprocessor_var == nullptr)
 	{
 		return;
@@ -110,27 +372,70 @@ void DSS::executor_t::auto_preprocessors()
 	direct_exec(statements);
 }
 
-void DSS::executor_t::command_pass(DSS::definer_delegate_t definer, DSS::strvec_t statements)
+void DSS::executor_t::command_pass(const DSS::definer_delegate_t &definer, const DSS::strvec_t &statements, bool control_flow)
 {
 	m_loaded_commands.clear(); // Remove all currently defined commands (to mitigate interference)
 	definer.call(this);
 
-	direct_exec(statements);
+	direct_exec(statements, control_flow);
 }
 
 auto DSS::executor_t::exec_task(DSS::task_t task) -> DSS::return_type_t
 {
+	DSS_TRACE_TASK_START(m_id);
 	m_current_task = &task;
+	DSS::run_id_t outer_run_id = t_run_id;
+	t_run_id = m_id;
+	std::chrono::nanoseconds start = dss_utils::thread_cpu_now();
+	DSS::sched_clock_t::time_point wall_start = DSS::sched_clock_t::now();
+	std::uint64_t statements_before = m_cpu_usage.statements;
+	DSS::page_faults_t faults_before = m_fault_accounting == true ? DSS::memory::thread_page_faults() : DSS::page_faults_t();
+
+	// Shared buffers keep their statements, unless the preprocessors rewrite the script
+	DSS::strvec_t split = {};
+	auto statements = [&task, &split]() -> const DSS::strvec_t & {
+		const DSS::strvec_t *kept = task.statements();
+		if (kept != nullptr)
+		{
+			return *kept;
+		}
 
-	std::string &script = task.get_script();
-	DSS::strvec_t statements = dss_utils::string_split(script, DSS::key::MULTILINE_DELIM);
+		split = dss_utils::string_split(task.view(), DSS::key::MULTILINE_DELIM);
+		return split;
+	};
 
-	command_pass(m_additional_preprocessors, statements);
+	DSS_TRACE_PASS_START(m_id, DSS::trace::PASS_PREPROCESSOR);
+	command_pass(*m_additional_preprocessors, statements());
 	auto_preprocessors();
+	DSS_TRACE_PASS_END(m_id, DSS::trace::PASS_PREPROCESSOR);
+
+	DSS_TRACE_PASS_START(m_id, DSS::trace::PASS_COMMAND);
+	command_pass(*m_additional_commands, statements(), true); // Update after the preprocessors are finished
+	DSS_TRACE_PASS_END(m_id, DSS::trace::PASS_COMMAND);
 
-	statements = dss_utils::string_split(script, DSS::key::MULTILINE_DELIM); // Update after the preprocessors are finished
+	std::chrono::nanoseconds elapsed = dss_utils::thread_cpu_now() - start;
+	m_cpu_usage.tasks++;
+	m_cpu_usage.task_time += elapsed;
+	m_cpu_usage.last_task_time = elapsed;
+	m_cpu_usage.max_task_time = std::max(m_cpu_usage.max_task_time, elapsed);
+	m_current_task = nullptr;
+	t_run_id = outer_run_id;
 
-	command_pass(m_additional_commands, statements);
+	if (m_fault_accounting == true)
+	{
+		DSS::page_faults_t faults = DSS::memory::thread_page_faults();
+		m_cpu_usage.page_faults.minor += faults.minor - faults_before.minor;
+		m_cpu_usage.page_faults.major += faults.major - faults_before.major;
+	}
+
+	DSS::metrics::record_task(DSS::sched_clock_t::now() - wall_start, m_cpu_usage.statements - statements_before);
+
+	if (m_journal != nullptr)
+	{
+		m_journal->capture(m_exec_vars);
+	}
+
+	DSS_TRACE_TASK_END(m_id, 0);
 
 	return 0;
 }
@@ -149,16 +454,22 @@ auto DSS::executor_t::exec_all_tasks(bool recursive) -> DSS::delegate_return_t
 	}
 	m_busy = true;
 
-	for (auto task : m_tasks)
+	// Tasks are moved out, so their buffers are never copied
+	std::vector<DSS::task_t> tasks = std::move(m_task_spare);
+	tasks.swap(m_tasks);
+	for (auto &task : tasks)
 	{
-		exec_task(task);
+		exec_task(std::move(task));
 	}
+	tasks.clear();
+	m_task_spare = std::move(tasks);
 
 	m_busy = false;
 	m_tasks.clear(); // All tasks are completed, whether successfully or not
+	exec_independent_tasks();
 	if (recursive == true)
 	{
-		m_tasks.insert(m_tasks.end(), m_task_buffer.begin(), m_task_buffer.end());
+		m_tasks.insert(m_tasks.end(), std::make_move_iterator(m_task_buffer.begin()), std::make_move_iterator(m_task_buffer.end()));
 		m_task_buffer.clear();
 
 		exec_all_tasks(DSS::key::FLAG_RECURSIVE_EXECUTION);
@@ -167,28 +478,387 @@ auto DSS::executor_t::exec_all_tasks(bool recursive) -> DSS::delegate_return_t
 	return res;
 }
 
-void DSS::environment_t::apply_error_key(DSS::err_key_t key) { m_lookup_error.insert(key.begin(), key.end()); }
+DSS::environment_t::environment_t()
+{
+	m_id_max = 0;
+	m_additional_commands = definer_delegate_t(32);
+	m_additional_preprocessors = definer_delegate_t(32);
+	m_scheduler = std::make_unique<DSS::scheduler_t>();
+	m_work_pool = std::make_unique<DSS::work_pool_t>();
+	m_scripts = std::make_unique<DSS::script_store_t>();
+}
 
-void DSS::executor_t::exec(std::string script)
+DSS::environment_t::~environment_t()
 {
-	DSS::task_t task = DSS::task_t(script);
-	m_tasks.push_back(task);							// Append a task to the task list
-	exec_all_tasks(DSS::key::FLAG_RECURSIVE_EXECUTION); // Invoke the executor
+	m_scheduler->stop();
+	m_work_pool->stop();
 }
 
-auto DSS::environment_t::executor_by_id(DSS::run_id_t id) -> std::shared_ptr<DSS::executor_t>
+void DSS::environment_t::start_workers(std::size_t workers)
+{
+	m_scheduler->start(workers);
+	m_work_pool->start(workers);
+}
+
+auto DSS::environment_t::reserve_memory(DSS::memory_options_t options) -> bool
+{
+	m_memory = options;
+	bool res = true;
+
+	// Locked first, so that the heap reserve is locked as it grows
+	if (options.lock == true && DSS::memory::lock() == false)
+	{
+		DSS::push_error(DSS::memory::err::LOCK);
+		res = false;
+	}
+
+	for (auto &executor : m_executors)
+	{
+		executor->reserve_memory(options);
+	}
+
+	if (DSS::memory::reserve_heap(options.heap * m_executors.size(), options.huge_pages) == false)
+	{
+		DSS::push_error(DSS::memory::err::RESERVE);
+		res = false;
+	}
+
+	return res;
+}
+
+auto DSS::environment_t::reserve_executor_memory(DSS::executor_t &executor) -> bool
+{
+	executor.reserve_memory(*m_memory);
+
+	// The reserve is kept free for every executor at once
+	if (DSS::memory::reserve_heap(m_memory->heap * m_executors.size(), m_memory->huge_pages) == false)
+	{
+		DSS::push_error(executor.get_id(), DSS::memory::err::RESERVE);
+		return false;
+	}
+
+	return true;
+}
+
+auto DSS::environment_t::submit(DSS::run_id_t id, std::string script, std::optional<DSS::deadline_t> deadline) -> std::future<DSS::return_type_t>
+{
+	return submit(id, m_scripts->intern(std::move(script)), deadline);
+}
+
+auto DSS::environment_t::submit(DSS::run_id_t id, std::shared_ptr<const DSS::script_buffer_t> script, std::optional<DSS::deadline_t> deadline)
+	-> std::future<DSS::return_type_t>
+{
+	return m_scheduler->submit(executor_by_id(id), DSS::task_t(std::move(script)), deadline);
+}
+
+auto DSS::executor_t::hibernate() -> bool
+{
+	if (m_hibernated.has_value() == true)
+	{
+		return true;
+	}
+
+	if (m_busy == true || m_tasks.size() > 0 || m_task_buffer.size() > 0 || m_independent_buffer.size() > 0)
+	{
+		return false;
+	}
+
+	// Only hibernate if nothing would be lost
+	for (std::shared_ptr<const DSS::var_t<std::any>> var : m_exec_vars.all())
+	{
+		for (const auto &element : var->get_data())
+		{
+			if (element.type() != typeid(std::string) && element.type() != typeid(std::int64_t) && element.type() != typeid(lang::alias_t))
+			{
+				return false;
+			}
+		}
+	}
+
+	std::string packed = DSS::snapshot::encode(m_exec_vars);
+	for (std::shared_ptr<const DSS::var_t<std::any>> var : m_exec_vars.all())
+	{
+		std::uint64_t version = var->get_version();
+		packed.append(reinterpret_cast<const char *>(&version), sizeof(version));
+	}
+	packed.shrink_to_fit();
+	m_hibernated = std::move(packed);
+
+	m_exec_vars = DSS::vars_t();
+	std::deque<DSS::command_t>().swap(m_loaded_commands);
+	std::vector<DSS::task_t>().swap(m_tasks);
+	std::vector<DSS::task_t>().swap(m_task_buffer);
+	std::vector<DSS::task_t>().swap(m_independent_buffer);
+
+	return true;
+}
+
+auto DSS::executor_t::rehydrate() -> bool
+{
+	const std::string &packed = m_hibernated.value();
+	DSS::vars_t vars = DSS::vars_t();
+
+	// The versions follow the snapshot, one per variable in the same order
+	if (DSS::snapshot::decode(packed.data(), packed.size(), vars) == false || packed.size() < vars.all().size() * sizeof(std::uint64_t))
+	{
+		DSS::push_error(m_id, DSS::err::REHYDRATE);
+		return false;
+	}
+
+	const char *versions = packed.data() + packed.size() - vars.all().size() * sizeof(std::uint64_t);
+	for (std::size_t i = 0; i < vars.all().size(); i++)
+	{
+		std::uint64_t version = 0;
+		std::memcpy(&version, versions + i * sizeof(version), sizeof(version));
+		vars.all()[i]->restore_version(version);
+	}
+
+	m_exec_vars = std::move(vars);
+	m_hibernated = std::nullopt;
+	return true;
+}
+
+auto DSS::executor_t::fork() -> std::shared_ptr<DSS::executor_t>
+{
+	std::shared_ptr<DSS::executor_t> child = std::make_shared<DSS::executor_t>(m_id, m_additional_preprocessors, m_additional_commands, m_lookup_error);
+
+	child->m_exec_vars = get_vars().clone();
+	child->m_work_pool = m_work_pool;
+	child->m_handler_accounting = m_handler_accounting;
+	child->m_fault_accounting = m_fault_accounting;
+	child->m_directory = m_directory;
+	child->m_dispatch_hooks = m_dispatch_hooks;
+	child->m_forked = true;
+
+	for (const auto &var : child->m_exec_vars.all())
+	{
+		child->m_fork_stamps[var->get_id()] = var->get_stamp();
+	}
+
+	return child;
+}
+
+void DSS::executor_t::exec_independent_tasks()
+{
+	if (m_independent_buffer.size() == 0)
+	{
+		return;
+	}
+
+	std::vector<DSS::task_t> tasks = {};
+	tasks.swap(m_independent_buffer);
+
+	std::vector<std::shared_ptr<DSS::executor_t>> children = {};
+	std::vector<DSS::work_pool_t::work_t> work = {};
+	children.reserve(tasks.size());
+	work.reserve(tasks.size());
+
+	for (auto &task : tasks)
+	{
+		std::shared_ptr<DSS::executor_t> child = fork();
+		child->m_held = std::make_unique<DSS::held_output_t>();
+		children.push_back(child);
+		work.push_back([child, &task]() {
+			DSS::held_output_t *outer = t_held;
+			t_held = child->m_held.get();
+			child->exec(std::move(task));
+			t_held = outer;
+		});
+	}
+
+	if (m_work_pool != nullptr)
+	{
+		m_work_pool->run_all(work);
+	}
+	else
+	{
+		for (auto &func : work)
+		{
+			func();
+		}
+	}
+
+	// Merge in the order the tasks were queued, so the result does not depend on timing
+	for (auto &child : children)
+	{
+		child->m_held->replay(output(), m_held.get());
+		merge(*child);
+		m_cpu_usage.tasks += child->m_cpu_usage.tasks;
+		m_cpu_usage.statements += child->m_cpu_usage.statements;
+		m_cpu_usage.task_time += child->m_cpu_usage.task_time;
+		m_cpu_usage.handler_time += child->m_cpu_usage.handler_time;
+		m_cpu_usage.page_faults.minor += child->m_cpu_usage.page_faults.minor;
+		m_cpu_usage.page_faults.major += child->m_cpu_usage.page_faults.major;
+	}
+
+	if (m_journal != nullptr)
+	{
+		m_journal->capture(m_exec_vars);
+	}
+}
+
+namespace
+{
+
+auto any_equal(const std::any &a, const std::any &b) -> bool
+{
+	if (a.type() != b.type())
+	{
+		return false;
+	}
+
+	if (a.type() == typeid(std::string))
+	{
+		return std::any_cast<const std::string &>(a) == std::any_cast<const std::string &>(b);
+	}
+	if (a.type() == typeid(std::int64_t))
+	{
+		return std::any_cast<std::int64_t>(a) == std::any_cast<std::int64_t>(b);
+	}
+	if (a.type() == typeid(lang::alias_t))
+	{
+		const lang::alias_t &aa = std::any_cast<const lang::alias_t &>(a);
+		const lang::alias_t &ab = std::any_cast<const lang::alias_t &>(b);
+		return aa.id == ab.id && aa.value == ab.value;
+	}
+
+	return false;
+}
+
+} // namespace
+
+void DSS::executor_t::merge(DSS::executor_t &child)
 {
-	for (auto executor : m_executors)
+	for (std::shared_ptr<const DSS::var_t<std::any>> child_var : child.m_exec_vars.all())
 	{
-		if (executor->get_id() != id)
+		const std::string &id = child_var->get_id();
+		const std::vector<std::any> &child_data = child_var->get_data();
+
+		auto forked = child.m_fork_stamps.find(id);
+		if (forked != child.m_fork_stamps.end() && forked->second == child_var->get_stamp())
 		{
+			continue; // Untouched by the child
+		}
+
+		std::shared_ptr<DSS::var_t<std::any>> var = m_exec_vars.get_or_add_var(id);
+		std::vector<std::any> &data = var->get_data();
+
+		if (child_data.size() == 1 && data.size() <= 1 && child_data[0].type() != typeid(lang::alias_t))
+		{
+			data = child_data;
 			continue;
 		}
 
-		return executor;
+		for (const auto &element : child_data)
+		{
+			bool merged = false;
+
+			for (auto &existing : data)
+			{
+				if (element.type() == typeid(lang::alias_t) && existing.type() == typeid(lang::alias_t) &&
+					std::any_cast<const lang::alias_t &>(element).id == std::any_cast<const lang::alias_t &>(existing).id)
+				{
+					existing = element;
+					merged = true;
+					break;
+				}
+
+				if (any_equal(element, existing) == true)
+				{
+					merged = true;
+					break;
+				}
+			}
+
+			if (merged == false)
+			{
+				data.push_back(element);
+			}
+		}
+	}
+}
+
+void DSS::environment_t::add_pre_dispatch_hook(DSS::pre_dispatch_hook_t hook)
+{
+	std::shared_ptr<DSS::dispatch_hooks_t> hooks = std::make_shared<DSS::dispatch_hooks_t>();
+	if (m_dispatch_hooks != nullptr)
+	{
+		*hooks = *m_dispatch_hooks;
+	}
+	hooks->pre.push_back(hook);
+
+	m_dispatch_hooks = hooks;
+	for (auto &executor : m_executors)
+	{
+		executor->set_dispatch_hooks(m_dispatch_hooks);
+	}
+}
+
+void DSS::environment_t::add_post_dispatch_hook(DSS::post_dispatch_hook_t hook)
+{
+	std::shared_ptr<DSS::dispatch_hooks_t> hooks = std::make_shared<DSS::dispatch_hooks_t>();
+	if (m_dispatch_hooks != nullptr)
+	{
+		*hooks = *m_dispatch_hooks;
+	}
+	hooks->post.push_back(hook);
+
+	m_dispatch_hooks = hooks;
+	for (auto &executor : m_executors)
+	{
+		executor->set_dispatch_hooks(m_dispatch_hooks);
+	}
+}
+
+void DSS::environment_t::clear_dispatch_hooks()
+{
+	m_dispatch_hooks = nullptr;
+	for (auto &executor : m_executors)
+	{
+		executor->set_dispatch_hooks(nullptr);
 	}
+}
+
+void DSS::executor_t::reserve_memory(const DSS::memory_options_t &options)
+{
+	m_tasks.reserve(options.tasks);
+	m_task_spare.reserve(options.tasks);
+	m_task_buffer.reserve(options.tasks);
+	m_independent_buffer.reserve(options.tasks);
+	m_exec_vars.reserve(options.vars);
+	m_fault_accounting = true;
+}
 
-	return nullptr;
+void DSS::environment_t::apply_error_key(DSS::err_key_t key)
+{
+	m_lookup_error.insert(key.begin(), key.end());
+	m_shared_lookup_error = nullptr;
+}
+
+void DSS::executor_t::exec(DSS::task_t task)
+{
+	if (m_hibernated.has_value() == true && rehydrate() == false)
+	{
+		return; // Not run against the empty variables of a failed rehydration
+	}
+
+	m_tasks.push_back(std::move(task)); // Append a task to the task list
+	DSS_TRACE_QUEUE_ENQUEUE(m_id, DSS::trace::QUEUE_TASK, m_tasks.size());
+	exec_all_tasks(DSS::key::FLAG_RECURSIVE_EXECUTION); // Invoke the executor
+}
+
+auto DSS::environment_t::executor_by_id(DSS::run_id_t id) -> std::shared_ptr<DSS::executor_t>
+{
+	// Executors are spawned in order of their (increasing) ids
+	auto found = std::lower_bound(m_executors.begin(), m_executors.end(), id,
+								  [](const std::shared_ptr<DSS::executor_t> &executor, DSS::run_id_t id) { return executor->get_id() < id; });
+
+	if (found == m_executors.end() || (*found)->get_id() != id)
+	{
+		return nullptr;
+	}
+
+	return *found;
 }
 
 void DSS::environment_t::init()
@@ -203,7 +873,7 @@ void DSS::environment_t::init()
 
 	if (main_ex == nullptr)
 	{
-		std::cout << "[warning] failure to produce a main executor, initialization sequence incomplete." << std::endl;
+		DSS::logger().push(DSS::log_level_t::WARNING, "failure to produce a main executor, initialization sequence incomplete.");
 		return;
 	}
 
@@ -223,14 +893,19 @@ const std::string ERROR_TOO_FEW_ARGS = "Too few arguments provided to command";
  */
 auto DSS::command_t::attempt_parse_and_exec(DSS::strvec_t tokens, uint64_t line) -> delegate_return_t
 {
-	delegate_return_t res = {};
-
 	if (tokens[0] != m_name)
 		return {};
 
 	tokens.erase(tokens.begin());
 
-	std::size_t arg_count = tokens.size();
+	return exec(tokens, line);
+}
+
+auto DSS::command_t::exec(const DSS::func_args_t &args, uint64_t line) const -> delegate_return_t
+{
+	delegate_return_t res = {};
+
+	std::size_t arg_count = args.size();
 
 	if (m_maximum_args > -1 && std::int32_t(arg_count) > m_maximum_args)
 	{
@@ -255,6 +930,6 @@ auto DSS::command_t::attempt_parse_and_exec(DSS::strvec_t tokens, uint64_t line)
 		return res;
 	}
 
-	res = m_delegate.call(m_parent_ex, tokens);
+	res = m_delegate.call(m_parent_ex, args);
 	return res;
 }
\ No newline at end of file
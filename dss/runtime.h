@@ -2,20 +2,63 @@
 #define H_RUNTIME
 
 #include <any>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <future>
+#include <functional>
+#include <iostream>
 #include <memory>
 #include <map>
+#include <span>
+#include <sstream>
+#include <string_view>
+#include <unordered_map>
 
 #include "dss_utils.h"
+#include "memory.h"
+#include "trace.h"
 
 namespace DSS
 {
 
-void push_error(std::string what, int line = -1);
-
 class executor_t;
 
+class scheduler_t;
+class work_pool_t;
+class script_store_t;
+class journal_t;
+
+namespace ir
+{
+struct program_t;
+} // namespace ir
+
 typedef int64_t run_id_t;
 
+/**
+ * The run id of errors which were not pushed by an executor
+ */
+const run_id_t NO_RUN_ID = -1;
+
+/**
+ * Reports an error. It is attributed to the executor running a task
+ * on the calling thread, if any.
+ */
+void push_error(std::string what, int line = -1);
+
+/**
+ * Reports an error of the executor `run_id`
+ */
+void push_error(run_id_t run_id, std::string what, int line = -1);
+
+typedef std::chrono::steady_clock sched_clock_t;
+
+/**
+ * An absolute point in time by which a task should be complete
+ */
+typedef sched_clock_t::time_point deadline_t;
+
 typedef std::map<uint, std::string> err_codes_t;
 typedef std::map<std::string, err_codes_t> err_key_t;
 
@@ -94,6 +137,23 @@ public:
 	 */
 	auto attempt_parse_and_exec(strvec_t tokens, std::uint64_t line) -> delegate_return_t;
 
+	/**
+	 * Runs this command with already separated arguments,
+	 * validating the amount of arguments first.
+	 *
+	 * @param args The arguments (the keyword excluded)
+	 * @param line The line of the statement, for error reporting
+	 *
+	 * @return The result of calling the delegate associated with this command.
+	 * Will return an empty vector if an error has occured;
+	 */
+	auto exec(const func_args_t &args, std::uint64_t line) const -> delegate_return_t;
+
+	/**
+	 * @return The keyword of the command
+	 */
+	auto get_name() const -> const std::string & { return m_name; }
+
 private:
 	dss_utils::Delegate<func_t, func_args_t, delegate_return_t> m_delegate = {32};
 	std::string m_name = {""};
@@ -103,10 +163,58 @@ private:
 	executor_t *m_parent_ex = {nullptr};
 };
 
+/**
+ * A command call, as seen by dispatch hooks
+ */
+struct dispatch_t
+{
+	run_id_t run_id = 0;
+
+	executor_t *executor = nullptr;
+
+	const command_t *command = nullptr;
+
+	/**
+	 * Views the arguments of the statement, valid for the duration of the hook
+	 */
+	std::span<const std::string> args = {};
+
+	std::int64_t line = -1;
+
+	/**
+	 * Status of the handler (post-dispatch only). Empty if the
+	 * handler could not be called, for instance with too few arguments.
+	 */
+	std::optional<return_type_t> status = std::nullopt;
+
+	/**
+	 * Wall-clock time of the call (post-dispatch only)
+	 */
+	std::chrono::nanoseconds elapsed = std::chrono::nanoseconds(0);
+};
+
+/**
+ * Observes a call before it is dispatched. Returning a status skips the
+ * handler, and reports that status instead (for fault injection).
+ */
+typedef std::function<std::optional<return_type_t>(const dispatch_t &)> pre_dispatch_hook_t;
+
+/**
+ * Observes a call after its handler returned
+ */
+typedef std::function<void(const dispatch_t &)> post_dispatch_hook_t;
+
+struct dispatch_hooks_t
+{
+	std::vector<pre_dispatch_hook_t> pre = {};
+	std::vector<post_dispatch_hook_t> post = {};
+};
+
 namespace err
 {
 const std::string NOT_A_COMMAND = "command does not exist or is not defined";
 const std::string UNKNOWN = "an unnamed critical exception occurred";
+const std::string REHYDRATE = "cannot restore the variables of a hibernated executor";
 } // namespace err
 
 namespace key
@@ -119,6 +227,36 @@ const std::string COMMENT_ID = "//";
 const bool FLAG_RECURSIVE_EXECUTION = true;
 } // namespace key
 
+/**
+ * A read-only script stored outside of a `std::string`, such as a mapped
+ * file. Tasks share the buffer, and release it once they are complete.
+ */
+class script_buffer_t
+{
+public:
+	virtual ~script_buffer_t() = default;
+
+	virtual auto view() const -> std::string_view = 0;
+
+	/**
+	 * @return The script split into statements, if the buffer keeps
+	 * them (see `stored_script_t`), or nullptr
+	 */
+	virtual auto statements() const -> const strvec_t * { return nullptr; }
+};
+
+/**
+ * Maps a file read-only, to be executed without copying it
+ *
+ * @warning The file must not be truncated while the buffer is alive: touching
+ * mapped pages past the new end of the file raises `SIGBUS`. Only map files
+ * which are replaced by renaming, never rewritten in place.
+ *
+ * @return The mapped file, or nullptr if it could not be opened or is not
+ * a regular file (pipes, such as /dev/stdin, cannot be mapped)
+ */
+auto map_script(const std::string &path) -> std::shared_ptr<const script_buffer_t>;
+
 /**
  * DSSTasks are scripts that require running
  *
@@ -128,17 +266,52 @@ class task_t
 {
 public:
 	/**
-	 * Constructs a task.
+	 * Constructs a task. Pass an rvalue to hand the
+	 * buffer over without copying it.
 	 *
 	 * @param script The script contents of the task
 	 */
-	task_t(const std::string script) { m_script = script; }
+	task_t(std::string script) { m_script = std::move(script); }
+
+	/**
+	 * Constructs a task which reads its script from a shared buffer,
+	 * until the script is rewritten (see `get_script`).
+	 */
+	task_t(std::shared_ptr<const script_buffer_t> buffer) { m_buffer = std::move(buffer); }
+
+	/**
+	 * @return The script of the task, without copying it
+	 */
+	auto view() const -> std::string_view { return m_buffer != nullptr ? m_buffer->view() : std::string_view(m_script); }
+
+	/**
+	 * @return The statements of the script, if its buffer keeps them, or nullptr
+	 */
+	auto statements() const -> const strvec_t * { return m_buffer != nullptr ? m_buffer->statements() : nullptr; }
 
 	/**
 	 * @return A reference to the script of the task.
-	 * Mutability is intentional.
+	 * Mutability is intentional. A script read from a shared
+	 * buffer is copied once, on the first call.
 	 */
-	auto get_script() -> std::string & { return m_script; }
+	auto get_script() -> std::string &
+	{
+		if (m_buffer != nullptr)
+		{
+			m_script.assign(m_buffer->view());
+			m_buffer = nullptr;
+		}
+		return m_script;
+	}
+
+	/**
+	 * Replaces the script of the task, releasing its shared buffer (if any)
+	 */
+	void set_script(std::string script)
+	{
+		m_script = std::move(script);
+		m_buffer = nullptr;
+	}
 
 private:
 	/**
@@ -146,11 +319,70 @@ private:
 	 * the task
 	 */
 	std::string m_script = {""};
+
+	/**
+	 * The script instead of `m_script`, while it is not rewritten
+	 */
+	std::shared_ptr<const script_buffer_t> m_buffer = nullptr;
+};
+
+/**
+ * CPU time consumed by an executor, measured with the
+ * thread CPU clock of whichever thread executed it.
+ */
+struct cpu_usage_t
+{
+	/**
+	 * The amount of completed tasks
+	 */
+	std::uint64_t tasks = 0;
+
+	/**
+	 * The amount of dispatched commands, over every task
+	 */
+	std::uint64_t statements = 0;
+
+	/**
+	 * CPU time spent on every task, handlers included
+	 */
+	std::chrono::nanoseconds task_time = std::chrono::nanoseconds(0);
+
+	/**
+	 * CPU time spent inside command handlers. Only
+	 * measured while handler accounting is enabled.
+	 */
+	std::chrono::nanoseconds handler_time = std::chrono::nanoseconds(0);
+
+	std::chrono::nanoseconds last_task_time = std::chrono::nanoseconds(0);
+	std::chrono::nanoseconds max_task_time = std::chrono::nanoseconds(0);
+
+	/**
+	 * Page faults taken while executing tasks. Only
+	 * counted while the executor has reserved memory.
+	 */
+	page_faults_t page_faults = {};
 };
 
 typedef std::any (*definer_t)(executor_t *);
 typedef dss_utils::Delegate<definer_t, executor_t *, std::vector<std::any>> definer_delegate_t;
 
+/**
+ * Identifies the contents of a variable: its serial is never reused by
+ * another variable, and its version advances whenever it is modified
+ */
+struct var_stamp_t
+{
+	std::uint64_t serial = 0;
+	std::uint64_t version = 0;
+
+	bool operator==(const var_stamp_t &) const = default;
+};
+
+/**
+ * @return A serial for a new variable, unique within the process
+ */
+auto next_var_serial() -> std::uint64_t;
+
 template <typename T> class var_t
 {
 public:
@@ -167,20 +399,67 @@ public:
 	 */
 	var_t(std::string id, std::vector<T> data)
 	{
-		m_id = id;
-		m_data = data;
+		m_id = std::move(id);
+		m_data = std::move(data);
+	}
+
+	/**
+	 * Copies the variable. The copy has a serial of its own.
+	 */
+	var_t(const var_t &other)
+	{
+		m_id = other.m_id;
+		m_data = other.m_data;
+		m_version = other.m_version;
+		m_index = other.m_index;
+		m_index_version = other.m_index_version;
 	}
 
+	var_t &operator=(const var_t &) = delete;
+
 	/**
 	 * @return A reference to the
 	 */
 	auto get_id() -> std::string & { return m_id; }
 
+	auto get_id() const -> const std::string & { return m_id; }
+
 	/**
 	 * @return A reference to a vector
 	 * containing the data of the variable.
+	 *
+	 * @note The variable is assumed to be modified
+	 * through the reference, and its version advances.
+	 */
+	auto get_data() -> std::vector<T> &
+	{
+		m_version++;
+		return m_data;
+	}
+
+	/**
+	 * @return A read-only reference to a vector
+	 * containing the data of the variable.
+	 */
+	auto get_data() const -> const std::vector<T> & { return m_data; }
+
+	/**
+	 * @return A counter which advances whenever the
+	 * variable may have been modified.
 	 */
-	auto get_data() -> std::vector<T> & { return m_data; }
+	auto get_version() const -> std::uint64_t { return m_version; }
+
+	/**
+	 * Restores the version of a variable recreated from a packed copy
+	 * of itself, so that its versions continue instead of repeating.
+	 */
+	void restore_version(std::uint64_t version) { m_version = version; }
+
+	/**
+	 * @return The serial and version of the variable, to tell
+	 * whether it was replaced or modified since
+	 */
+	auto get_stamp() const -> var_stamp_t { return {m_serial, m_version}; }
 
 	/**
 	 * @tparam A the type of the variable.
@@ -190,34 +469,85 @@ public:
 	 */
 	template <typename A> void append_data(A what)
 	{
-		bool found = false;
-		A *found_element;
-		for (auto element : m_data)
+		for (const auto &element : m_data)
 		{
-			try
+			const A *comp = std::any_cast<A>(&element);
+			if (comp == nullptr)
 			{
-				A comp = std::any_cast<A>(element);
-				if (comp != what)
-				{
-					continue;
-				}
-				found_element = &comp;
-				found = true;
+				return;
 			}
-			catch (std::bad_any_cast &_e)
+
+			if (*comp == what)
 			{
 				return;
 			}
 		}
 
-		if (found == true)
+		m_data.push_back(what);
+		m_version++;
+
+		return;
+	}
+
+	/**
+	 * Finds an element by key, for variables which hold
+	 * named elements (such as aliases).
+	 *
+	 * Lookups go through an index, which is rebuilt only if the
+	 * variable was modified other than by `put_keyed()`.
+	 *
+	 * @param key_of Returns the key of an element, or std::nullopt
+	 * if the element has none
+	 *
+	 * @return The position of the first element named `key`, if any
+	 */
+	template <typename K> auto find_keyed(const std::string &key, K key_of) -> std::optional<std::size_t>
+	{
+		if (m_index_version != m_version)
 		{
-			return;
+			m_index.clear();
+			for (std::size_t i = 0; i < m_data.size(); i++)
+			{
+				std::optional<std::string> element_key = key_of(m_data[i]);
+				if (element_key.has_value() == true)
+				{
+					m_index.emplace(element_key.value(), i);
+				}
+			}
+			m_index_version = m_version;
 		}
 
-		m_data.push_back(what);
+		auto found = m_index.find(key);
+		if (found == m_index.end())
+		{
+			return std::nullopt;
+		}
 
-		return;
+		return found->second;
+	}
+
+	/**
+	 * Replaces the element named `key`, or appends it if none exists.
+	 *
+	 * @param key_of See `find_keyed()`
+	 */
+	template <typename K> void put_keyed(const std::string &key, T what, K key_of)
+	{
+		std::optional<std::size_t> found = find_keyed(key, key_of);
+
+		if (found.has_value() == true)
+		{
+			m_data[found.value()] = what;
+		}
+		else
+		{
+			m_index.emplace(key, m_data.size());
+			m_data.push_back(what);
+		}
+
+		// The index stays current
+		m_version++;
+		m_index_version = m_version;
 	}
 
 private:
@@ -230,6 +560,16 @@ private:
 	 * The data of the variable
 	 */
 	std::vector<T> m_data;
+
+	std::uint64_t m_version = 0;
+
+	std::uint64_t m_serial = next_var_serial();
+
+	/**
+	 * Positions of elements by key, as of `m_index_version`
+	 */
+	std::unordered_map<std::string, std::size_t> m_index;
+	std::optional<std::uint64_t> m_index_version = std::nullopt;
 };
 
 const std::string AUTO_PREPROCESSOR_VAR = "auto_preprocessor";
@@ -249,16 +589,17 @@ public:
 	 *
 	 * @see Var
 	 */
-	void init_var(std::string id, std::vector<std::any> data)
+	void init_var(const std::string &id, std::vector<std::any> data)
 	{
 		if (has_var(id) == true)
 		{
 			return;
 		}
 
-		std::shared_ptr<var_t<std::any>> new_var = std::make_shared<var_t<std::any>>(id, data);
+		std::shared_ptr<var_t<std::any>> new_var = std::make_shared<var_t<std::any>>(id, std::move(data));
 
 		m_vars.push_back(new_var);
+		m_index.emplace(id, new_var);
 	}
 
 	/**
@@ -267,29 +608,15 @@ public:
 	 * @return A pointer to a generic (`std::any`) variable.
 	 * Will be `nullptr` if the variable is not found!
 	 */
-	auto get_var(std::string id) -> std::shared_ptr<var_t<std::any>>
+	auto get_var(const std::string &id) -> std::shared_ptr<var_t<std::any>>
 	{
-		/*
-		size_t index = 0;
-		std::vector<std::shared_ptr<Var<std::any>>>::iterator itr;
-		for (itr = m_vars.begin(); itr != m_vars.end(); itr++)
-		{
-			if (itr->get_id() != id) {index++; continue;}
-
-			return &(*itr);
-			index++;
-		}
-		*/
-
-		for (auto var : m_vars)
+		auto found = m_index.find(id);
+		if (found == m_index.end())
 		{
-			if (var->get_id() != id)
-				continue;
-
-			return var;
+			return nullptr;
 		}
 
-		return nullptr;
+		return found->second;
 	}
 
 	/**
@@ -299,7 +626,7 @@ public:
 	 * @return A pointer to the variable. This should
 	 * be safe to rely on.
 	 */
-	auto get_or_add_var(std::string id) -> std::shared_ptr<var_t<std::any>>
+	auto get_or_add_var(const std::string &id) -> std::shared_ptr<var_t<std::any>>
 	{
 		std::shared_ptr<var_t<std::any>> p_res = get_var(id);
 
@@ -318,20 +645,93 @@ public:
 	 *
 	 * @param id The id to compare against variables
 	 */
-	auto has_var(std::string id) -> bool
+	auto has_var(const std::string &id) -> bool
 	{
-		if (get_var(id) != nullptr)
+		if (m_index.find(id) != m_index.end())
 		{
 			return true;
 		}
 		return false;
 	}
 
+	/**
+	 * Produces a deep copy of every variable. Unlike copying `vars_t`,
+	 * the copy does not share variables with the original.
+	 */
+	auto clone() const -> vars_t
+	{
+		vars_t res = vars_t();
+		res.m_vars.reserve(m_vars.size());
+
+		for (const auto &var : m_vars)
+		{
+			std::shared_ptr<var_t<std::any>> copy = std::make_shared<var_t<std::any>>(*var);
+			res.m_vars.push_back(copy);
+			res.m_index.emplace(copy->get_id(), copy);
+		}
+
+		return res;
+	}
+
+	/**
+	 * Reserves room for `count` variables
+	 */
+	void reserve(std::size_t count)
+	{
+		m_vars.reserve(count);
+		m_index.reserve(count);
+	}
+
+	/**
+	 * @return Every variable, in order of creation
+	 */
+	auto all() const -> const std::vector<std::shared_ptr<var_t<std::any>>> & { return m_vars; }
+
 private:
 	/**
 	 * A vector of generic (`std::any`) environment variables
 	 */
 	std::vector<std::shared_ptr<var_t<std::any>>> m_vars;
+
+	/**
+	 * The same variables, by id
+	 */
+	std::unordered_map<std::string, std::shared_ptr<var_t<std::any>>> m_index;
+};
+
+/**
+ * Output and errors of a forked executor, held back until the fork is
+ * merged, so that they appear in the order the forks were queued rather
+ * than in the order their threads happened to run
+ */
+class held_output_t
+{
+public:
+	auto stream() -> std::ostream & { return m_output; }
+
+	void push_error(std::string what, int line);
+
+	/**
+	 * Writes everything held, in order, to `output`, and the errors to
+	 * `errors` (or the logger, if it is nullptr)
+	 */
+	void replay(std::ostream &output, held_output_t *errors);
+
+private:
+	struct record_t
+	{
+		bool error = false;
+		int line = -1;
+		std::string text = "";
+	};
+
+	std::ostringstream m_output;
+	std::vector<record_t> m_records;
+
+	/**
+	 * Moves the output written since the last record into a record
+	 */
+	void take_output();
 };
 
 /**
@@ -349,12 +749,25 @@ public:
 	 */
 	executor_t(run_id_t id, definer_delegate_t additional_preprocessors = definer_delegate_t(), definer_delegate_t additional_commands = definer_delegate_t(),
 		err_key_t lookup_error = err_key_t())
+		: executor_t(id, std::make_shared<const definer_delegate_t>(additional_preprocessors), std::make_shared<const definer_delegate_t>(additional_commands),
+			  std::make_shared<const err_key_t>(lookup_error))
+	{
+	}
+
+	/**
+	 * Produces a DSS executor which shares its definers and
+	 * error keys with other executors (for instance, every executor
+	 * of an environment).
+	 */
+	executor_t(run_id_t id, std::shared_ptr<const definer_delegate_t> additional_preprocessors, std::shared_ptr<const definer_delegate_t> additional_commands,
+		std::shared_ptr<const err_key_t> lookup_error)
 	{
 		m_loaded_commands = {};
 		m_additional_preprocessors = additional_preprocessors;
 		m_additional_commands = additional_commands;
 		m_tasks = {};
 		m_current_task = nullptr;
+		m_busy = false;
 		m_lookup_error = lookup_error;
 
 		m_id = id;
@@ -375,7 +788,43 @@ public:
 	/**
 	 * Queues a task while the executor is busy.
 	 */
-	void queue_task(task_t task) { m_task_buffer.push_back(task); }
+	void queue_task(task_t task)
+	{
+		m_task_buffer.push_back(std::move(task));
+		DSS_TRACE_QUEUE_ENQUEUE(m_id, DSS::trace::QUEUE_BUFFER, m_task_buffer.size());
+	}
+
+	/**
+	 * Queues a task which does not depend on other queued tasks.
+	 *
+	 * Once the current tasks are complete, independent tasks run
+	 * concurrently in forked executors (see `fork`), then their
+	 * variables are merged back in the order they were queued.
+	 */
+	void queue_independent_task(task_t task)
+	{
+		m_independent_buffer.push_back(std::move(task));
+		DSS_TRACE_QUEUE_ENQUEUE(m_id, DSS::trace::QUEUE_INDEPENDENT, m_independent_buffer.size());
+	}
+
+	/**
+	 * Produces a child executor with the same RunID, definers and
+	 * error keys, and a deep copy of this executor's variables.
+	 */
+	auto fork() -> std::shared_ptr<executor_t>;
+
+	/**
+	 * Provides the pool which runs independent tasks. Without a
+	 * pool, independent tasks run one after another.
+	 */
+	void set_work_pool(work_pool_t *pool) { m_work_pool = pool; }
+
+	/**
+	 * Journals the variables modified by every task.
+	 *
+	 * @see journal_t::attach
+	 */
+	void set_journal(journal_t *journal) { m_journal = journal; }
 
 	/**
 	 * Execute a DSS script. This is the
@@ -384,19 +833,76 @@ public:
 	 * When given input, the environment will create a task, then execute the task
 	 * after it is finished with all previous (older) tasks.
 	 *
-	 * @param script A string containing DSS script to execute
+	 * @param script A string containing DSS script to execute. Moving
+	 * the script in hands its buffer over, which is then not copied
+	 * through queueing and execution (unless aliases rewrite it).
 	 */
-	void exec(std::string script);
+	void exec(std::string script) { exec(task_t(std::move(script))); }
+
+	/**
+	 * Executes a script read from a buffer, such as a mapped file
+	 * (see `map_script`), which is only copied if aliases rewrite it.
+	 */
+	void exec(std::shared_ptr<const script_buffer_t> script) { exec(task_t(std::move(script))); }
+
+	void exec(task_t task);
 
 	/**
 	 * @return A clone of the executor's RunID
 	 */
 	auto get_id() -> run_id_t { return m_id; }
 
+	/**
+	 * @return The directory which relative paths of this executor's
+	 * commands (`ls`, `src`) resolve against. Empty for the current
+	 * directory of the process.
+	 */
+	auto get_directory() -> const std::string & { return m_directory; }
+
+	void set_directory(std::string directory) { m_directory = std::move(directory); }
+
+	/**
+	 * @return `path`, relative to the directory of this executor unless it is absolute
+	 */
+	auto resolve_path(const std::string &path) -> std::string
+	{
+		if (m_directory.empty() == true || path.empty() == true || path[0] == '/')
+		{
+			return path;
+		}
+
+		return m_directory + "/" + path;
+	}
+
 	/**
 	 * @return A reference to this executor's environment `Vars`.
+	 * A hibernated executor is rehydrated first. Should that fail, the
+	 * variables are empty and the executor stays hibernated.
+	 */
+	auto get_vars() -> vars_t &
+	{
+		if (m_hibernated.has_value() == true)
+		{
+			rehydrate();
+		}
+		return m_exec_vars;
+	}
+
+	/**
+	 * Compacts an idle executor into a minimal representation. Its
+	 * variables are packed into one contiguous snapshot, and its command,
+	 * task and fork buffers are released. The executor rehydrates itself
+	 * on its next task (or whenever its variables are accessed). Tasks are
+	 * refused, with an error, while its variables cannot be restored.
+	 *
+	 * @note Must not be called while the executor is executing.
+	 *
+	 * @return false if the executor is busy, has queued tasks, or holds
+	 * variables which snapshots cannot represent
 	 */
-	auto get_vars() -> vars_t & { return m_exec_vars; }
+	auto hibernate() -> bool;
+
+	auto is_hibernated() -> bool { return m_hibernated.has_value(); }
 
 	/**
 	 * @return A pointer to the currently procesing task.
@@ -404,22 +910,68 @@ public:
 	 */
 	auto get_current_task() -> task_t * { return m_current_task; }
 
+	/**
+	 * @return Where commands write their output: `std::cout`, unless
+	 * the executor is a fork running an independent task
+	 */
+	auto output() -> std::ostream & { return m_held != nullptr ? m_held->stream() : std::cout; }
+
+	/**
+	 * @return Whether the executor was produced by `fork`
+	 */
+	auto is_fork() -> bool { return m_forked; }
+
+	/**
+	 * @return The CPU time consumed by this executor.
+	 *
+	 * @note This is only consistent when read by the thread
+	 * executing the executor, or while the executor is idle.
+	 */
+	auto get_cpu_usage() -> const cpu_usage_t & { return m_cpu_usage; }
+
+	/**
+	 * Enables or disables measuring the CPU time of every single
+	 * command handler. This reads the thread CPU clock twice per
+	 * statement, and is disabled by default.
+	 */
+	void set_handler_accounting(bool enabled) { m_handler_accounting = enabled; }
+
+	/**
+	 * Sizes the task queues and variable store of this executor,
+	 * and starts counting the page faults of its tasks.
+	 *
+	 * @see environment_t::reserve_memory
+	 */
+	void reserve_memory(const memory_options_t &options);
+
+	/**
+	 * Observes every command call of this executor (and its forks).
+	 * Without hooks (`nullptr`), dispatch costs one extra branch.
+	 *
+	 * @note Hooks may be called from any worker thread. They should
+	 * only be replaced while the executor is idle.
+	 *
+	 * @see environment_t::add_pre_dispatch_hook
+	 */
+	void set_dispatch_hooks(std::shared_ptr<const dispatch_hooks_t> hooks) { m_dispatch_hooks = hooks; }
+
 private:
 	/**
 	 * Every command currently working for this
-	 * particular "pass" of execution
+	 * particular "pass" of execution. A deque, so that handlers defining
+	 * commands do not invalidate the command being dispatched.
 	 */
-	std::vector<command_t> m_loaded_commands;
+	std::deque<command_t> m_loaded_commands;
 
 	/**
 	 * Any user-defined preprocessor definers
 	 */
-	definer_delegate_t m_additional_preprocessors;
+	std::shared_ptr<const definer_delegate_t> m_additional_preprocessors;
 
 	/**
 	 * Any user-defined command definers
 	 */
-	definer_delegate_t m_additional_commands;
+	std::shared_ptr<const definer_delegate_t> m_additional_commands;
 
 	/**
 	 * Every single task that this environment
@@ -430,6 +982,24 @@ private:
 
 	std::vector<task_t> m_task_buffer;
 
+	std::vector<task_t> m_independent_buffer;
+
+	/**
+	 * Swapped with `m_tasks` while its tasks run, so that
+	 * the capacity of both is kept between passes
+	 */
+	std::vector<task_t> m_task_spare;
+
+	work_pool_t *m_work_pool = nullptr;
+
+	journal_t *m_journal = nullptr;
+
+	/**
+	 * Stamps of the variables at the time this executor
+	 * was forked. Empty unless this executor is a fork.
+	 */
+	std::map<std::string, DSS::var_stamp_t> m_fork_stamps;
+
 	/**
 	 * Data stored in the executor
 	 */
@@ -455,10 +1025,42 @@ private:
 	 */
 	task_t *m_current_task;
 
+	cpu_usage_t m_cpu_usage = {};
+
+	bool m_handler_accounting = false;
+
+	bool m_fault_accounting = false;
+
+	std::string m_directory = "";
+
+	std::shared_ptr<const dispatch_hooks_t> m_dispatch_hooks = nullptr;
+
+	bool m_forked = false;
+
+	/**
+	 * Output and errors of an independent task, until it is merged
+	 */
+	std::unique_ptr<held_output_t> m_held = nullptr;
+
 	/**
 	 * The error keys for every defined command
 	 */
-	err_key_t m_lookup_error;
+	std::shared_ptr<const err_key_t> m_lookup_error;
+
+	/**
+	 * The variables of a hibernated executor, packed into a
+	 * snapshot followed by their versions (see `hibernate`)
+	 */
+	std::optional<std::string> m_hibernated = std::nullopt;
+
+	/**
+	 * Restores the variables of a hibernated executor. If they cannot be
+	 * decoded, the executor stays hibernated, so that nothing is lost and
+	 * the next access tries again.
+	 *
+	 * @return false if the variables could not be decoded
+	 */
+	auto rehydrate() -> bool;
 
 	void find_and_push_error(std::string command, int code, int line = -1);
 
@@ -468,9 +1070,26 @@ private:
 	 * This function is intended exclusively
 	 * for the internals of the interpreter.
 	 *
+	 * @param statements The statements to execute
+	 *
+	 * @param control_flow Whether control flow statements (`if`, `while`, ...)
+	 * are honored. Only the "command" pass uses control flow.
+	 *
 	 * @see Executor::exec_task
 	 */
-	void direct_exec(strvec_t statements);
+	void direct_exec(const strvec_t &statements, bool control_flow = false);
+
+	/**
+	 * Runs a compiled statement stream against the loaded commands.
+	 *
+	 * @see ir::compile
+	 */
+	void run_program(const ir::program_t &program);
+
+	/**
+	 * Calls a command through the dispatch hooks
+	 */
+	auto hooked_exec(const command_t &command, const func_args_t &args, std::int64_t line) -> delegate_return_t;
 
 	/**
 	 * @brief Applies automatic preprocessors.
@@ -493,8 +1112,10 @@ private:
 	 *
 	 * @param statements A vector of individual command strings. These will
 	 * be further split into individual tokens by the command itself.
+	 *
+	 * @param control_flow Whether control flow statements are honored
 	 */
-	void command_pass(definer_delegate_t definer, strvec_t statements);
+	void command_pass(const definer_delegate_t &definer, const strvec_t &statements, bool control_flow = false);
 
 	/**
 	 * Consider this the actual executor- this will
@@ -517,6 +1138,20 @@ private:
 	 * execution for every single task.
 	 */
 	auto exec_all_tasks(bool recursive) -> DSS::delegate_return_t;
+
+	/**
+	 * Runs every queued independent task in a forked executor,
+	 * then merges the forks back into this executor.
+	 */
+	void exec_independent_tasks();
+
+	/**
+	 * Merges the variables a fork has modified into this executor.
+	 *
+	 * Aliases are merged by id, single (typed) values are replaced,
+	 * and any other list is merged as a union.
+	 */
+	void merge(executor_t &child);
 };
 
 /**
@@ -530,12 +1165,13 @@ public:
 	 * Constructs an environment with a default
 	 * maximum ID of zero (root id).
 	 */
-	environment_t()
-	{
-		m_id_max = 0;
-		m_additional_commands = definer_delegate_t(32);
-		m_additional_preprocessors = definer_delegate_t(32);
-	}
+	environment_t();
+
+	/**
+	 * Stops the worker threads (if any) after every
+	 * submitted task is complete.
+	 */
+	~environment_t();
 
 	void apply_error_key(err_key_t key);
 
@@ -547,7 +1183,11 @@ public:
 	 *
 	 * @see Executor::connect_command_definer
 	 */
-	void connect_preprocessor_definer(const definer_t func) { m_additional_preprocessors.connect(func); }
+	void connect_preprocessor_definer(const definer_t func)
+	{
+		m_additional_preprocessors.connect(func);
+		m_shared_preprocessors = nullptr;
+	}
 
 	/**
 	 * Connect a command definer to the environment. Crucial
@@ -557,16 +1197,46 @@ public:
 	 *
 	 * @see Executor::connect_preprocessor_definer
 	 */
-	void connect_command_definer(const definer_t func) { m_additional_commands.connect(func); }
+	void connect_command_definer(const definer_t func)
+	{
+		m_additional_commands.connect(func);
+		m_shared_commands = nullptr;
+	}
 
 	/**
 	 * Spawns an executor, gives it a unique RunID, and appends it to `m_excutors`
+	 *
+	 * @return The new executor
 	 */
-	void spawn_executor()
+	auto spawn_executor() -> std::shared_ptr<executor_t>
 	{
+		// Executors share one copy of the definers and error keys
+		if (m_shared_preprocessors == nullptr)
+		{
+			m_shared_preprocessors = std::make_shared<const definer_delegate_t>(m_additional_preprocessors);
+		}
+		if (m_shared_commands == nullptr)
+		{
+			m_shared_commands = std::make_shared<const definer_delegate_t>(m_additional_commands);
+		}
+		if (m_shared_lookup_error == nullptr)
+		{
+			m_shared_lookup_error = std::make_shared<const err_key_t>(m_lookup_error);
+		}
+
 		std::shared_ptr<executor_t> new_executor =
-			std::make_shared<executor_t>(unique_runid(), m_additional_preprocessors, m_additional_commands, m_lookup_error);
+			std::make_shared<executor_t>(unique_runid(), m_shared_preprocessors, m_shared_commands, m_shared_lookup_error);
+		new_executor->set_work_pool(m_work_pool.get());
+		new_executor->set_dispatch_hooks(m_dispatch_hooks);
 		m_executors.emplace_back(new_executor);
+		m_executor_count.store(m_executors.size(), std::memory_order_relaxed);
+
+		if (m_memory.has_value() == true)
+		{
+			reserve_executor_memory(*new_executor);
+		}
+
+		return new_executor;
 	}
 
 	/**
@@ -592,6 +1262,94 @@ public:
 		return m_executors[0];
 	}
 
+	/**
+	 * Lazily retrieves the executor with RunID `id`.
+	 *
+	 * @param id The id of the executor to attempt and find
+	 *
+	 * @return The executor, or nullptr if it does not exist.
+	 */
+	auto executor_by_id(run_id_t id) -> std::shared_ptr<executor_t>;
+
+	/**
+	 * Starts the worker threads which execute submitted tasks, and
+	 * as many work-stealing threads for independent tasks.
+	 *
+	 * @param workers The amount of worker threads shared between every executor
+	 */
+	void start_workers(std::size_t workers);
+
+	/**
+	 * Reserves and prefaults memory for every executor (current and
+	 * future), so that real-time executors do not page fault on the
+	 * first touch of their queues, variables and heap allocations.
+	 *
+	 * @note Should be called before the workers are started: threads
+	 * which already allocated keep allocating from their own heap.
+	 *
+	 * @return false if part of the reservation failed (the rest applies)
+	 *
+	 * @see memory_options_t
+	 */
+	auto reserve_memory(memory_options_t options) -> bool;
+
+	/**
+	 * Submits a script to an executor of this environment. It will
+	 * be executed by a worker thread, earliest deadline first.
+	 *
+	 * @note Once an executor receives submitted tasks, it should not
+	 * be executed directly (`executor_t::exec`) from other threads.
+	 *
+	 * @see scheduler_t::submit
+	 */
+	auto submit(run_id_t id, std::string script, std::optional<deadline_t> deadline = std::nullopt) -> std::future<return_type_t>;
+
+	/**
+	 * Submits a buffer, such as one interned in the script store, without copying it
+	 */
+	auto submit(run_id_t id, std::shared_ptr<const script_buffer_t> script, std::optional<deadline_t> deadline = std::nullopt)
+		-> std::future<return_type_t>;
+
+	/**
+	 * @return The store which shares identical scripts between executors.
+	 * Submitted scripts are interned automatically.
+	 */
+	auto get_script_store() -> script_store_t & { return *m_scripts; }
+
+	/**
+	 * @return The scheduler of the environment, for admission
+	 * control and statistics.
+	 */
+	auto get_scheduler() -> scheduler_t & { return *m_scheduler; }
+
+	auto get_work_pool() -> work_pool_t & { return *m_work_pool; }
+
+	/**
+	 * @return The amount of executors, readable from any thread
+	 */
+	auto executor_count() -> std::size_t { return m_executor_count.load(std::memory_order_relaxed); }
+
+	/**
+	 * Registers a hook called before every command call, on
+	 * every executor of the environment (current and future).
+	 *
+	 * @note Hooks should only be registered while no task is running.
+	 *
+	 * @see executor_t::set_dispatch_hooks
+	 */
+	void add_pre_dispatch_hook(pre_dispatch_hook_t hook);
+
+	/**
+	 * Registers a hook called after every command call, on
+	 * every executor of the environment (current and future).
+	 */
+	void add_post_dispatch_hook(post_dispatch_hook_t hook);
+
+	/**
+	 * Removes every dispatch hook
+	 */
+	void clear_dispatch_hooks();
+
 private:
 	/**
 	 * The maximum executor ID.
@@ -606,6 +1364,7 @@ private:
 	 * currently alive in this environment.
 	 */
 	std::vector<std::shared_ptr<executor_t>> m_executors;
+	std::atomic<std::size_t> m_executor_count = 0;
 
 	/**
 	 * Definer delegate containing additional preprocessor definers.
@@ -620,24 +1379,45 @@ private:
 	err_key_t m_lookup_error;
 
 	/**
-	 * Generates a unique RunID. This is
-	 * useful when spawning executors.
+	 * Copies of the definers and error keys shared by spawned executors.
+	 * Reset whenever the originals change.
 	 */
-	auto unique_runid() -> run_id_t
-	{
-		return m_id_max;
-		m_id_max++;
-	}
+	std::shared_ptr<const definer_delegate_t> m_shared_preprocessors;
+	std::shared_ptr<const definer_delegate_t> m_shared_commands;
+	std::shared_ptr<const err_key_t> m_shared_lookup_error;
 
 	/**
-	 * Lazily retrieves the executor with RunID `id`.
-	 *
-	 * @param id The id of the executor to attempt and find
-	 *
-	 * @return An optional containing the executor, if it
-	 * exists.
+	 * Shared by every executor. Null while no hook is registered.
 	 */
-	auto executor_by_id(run_id_t id) -> std::shared_ptr<executor_t>;
+	std::shared_ptr<const dispatch_hooks_t> m_dispatch_hooks;
+
+	/**
+	 * Shares worker threads between the executors
+	 */
+	std::unique_ptr<scheduler_t> m_scheduler;
+
+	/**
+	 * Runs independent tasks of every executor
+	 */
+	std::unique_ptr<work_pool_t> m_work_pool;
+
+	std::unique_ptr<script_store_t> m_scripts;
+
+	/**
+	 * Applied to every spawned executor, once set
+	 */
+	std::optional<memory_options_t> m_memory = std::nullopt;
+
+	/**
+	 * Reserves the memory of one more executor
+	 */
+	auto reserve_executor_memory(executor_t &executor) -> bool;
+
+	/**
+	 * Generates a unique RunID. This is
+	 * useful when spawning executors.
+	 */
+	auto unique_runid() -> run_id_t { return m_id_max++; }
 };
 
 }; // namespace DSS
@@ -0,0 +1,366 @@
+#include "scheduler.h"
+
+namespace
+{
+
+auto utilization_of(const DSS::rt_params_t &params) -> double
+{
+	if (params.period.count() <= 0)
+	{
+		return 1.0;
+	}
+
+	return double(params.budget.count()) / double(params.period.count());
+}
+
+} // namespace
+
+void DSS::scheduler_t::start(std::size_t workers)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (m_workers.empty() == false || workers == 0)
+	{
+		return;
+	}
+
+	m_stopping = false;
+	for (std::size_t i = 0; i < workers; i++)
+	{
+		m_workers.emplace_back(&DSS::scheduler_t::worker_loop, this);
+	}
+}
+
+void DSS::scheduler_t::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_cv.notify_all();
+
+	for (auto &worker : m_workers)
+	{
+		worker.join();
+	}
+	m_workers.clear();
+}
+
+auto DSS::scheduler_t::admit(std::shared_ptr<DSS::executor_t> executor, DSS::rt_params_t params) -> bool
+{
+	if (executor == nullptr || params.period.count() <= 0 || params.budget.count() <= 0)
+	{
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (m_workers.empty() == true)
+	{
+		return false;
+	}
+
+	double total = utilization_of(params);
+	double max = utilization_of(params);
+
+	for (auto &[id, slot] : m_slots)
+	{
+		if (id == executor->get_id() || slot.rt.has_value() == false)
+		{
+			continue;
+		}
+
+		double u = utilization_of(slot.rt.value());
+		total += u;
+		max = std::max(max, u);
+	}
+
+	double m = double(m_workers.size());
+	if (max > 1.0 || total > m - (m - 1.0) * max)
+	{
+		return false;
+	}
+
+	slot_t &slot = m_slots[executor->get_id()];
+	slot.executor = executor;
+	slot.rt = params;
+
+	return true;
+}
+
+void DSS::scheduler_t::release(DSS::run_id_t id)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto found = m_slots.find(id);
+	if (found == m_slots.end())
+	{
+		return;
+	}
+
+	found->second.rt = std::nullopt;
+}
+
+auto DSS::scheduler_t::submit(std::shared_ptr<DSS::executor_t> executor, DSS::task_t task, std::optional<DSS::deadline_t> deadline)
+	-> std::future<DSS::return_type_t>
+{
+	job_t job = {std::move(task), {}, {}, false};
+	std::future<DSS::return_type_t> res = job.result.get_future();
+
+	if (executor == nullptr)
+	{
+		job.result.set_value(1);
+		return res;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		slot_t &slot = m_slots[executor->get_id()];
+		slot.executor = executor;
+
+		if (deadline.has_value() == true)
+		{
+			job.deadline = deadline.value();
+		}
+		else if (slot.rt.has_value() == true)
+		{
+			const rt_params_t &rt = slot.rt.value();
+			job.deadline = DSS::sched_clock_t::now() + (rt.deadline.count() > 0 ? rt.deadline : rt.period);
+		}
+		else
+		{
+			job.deadline = DSS::sched_clock_t::now() + DSS::DEFAULT_RELATIVE_DEADLINE;
+		}
+
+		slot.jobs.push_back(std::move(job));
+		slot.stats.pending++;
+		m_pending++;
+		DSS_TRACE_QUEUE_ENQUEUE(executor->get_id(), DSS::trace::QUEUE_SCHEDULER, slot.jobs.size());
+	}
+	m_cv.notify_one();
+
+	return res;
+}
+
+auto DSS::scheduler_t::stats(DSS::run_id_t id) -> DSS::sched_stats_t
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto found = m_slots.find(id);
+	if (found == m_slots.end())
+	{
+		return {};
+	}
+
+	return found->second.stats;
+}
+
+auto DSS::scheduler_t::total_deadline_misses() -> std::uint64_t
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_total_misses;
+}
+
+auto DSS::scheduler_t::utilization() -> double
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	double total = 0.0;
+	for (auto &[id, slot] : m_slots)
+	{
+		if (slot.rt.has_value() == true)
+		{
+			total += utilization_of(slot.rt.value());
+		}
+	}
+
+	return total;
+}
+
+auto DSS::scheduler_t::queue_depth() -> std::size_t
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_pending;
+}
+
+void DSS::scheduler_t::set_group(DSS::run_id_t id, std::string group)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_slots[id].group = group;
+	m_groups[group];
+}
+
+void DSS::scheduler_t::set_quota(std::string group, DSS::quota_t quota)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_groups[group].usage.quota = quota;
+}
+
+void DSS::scheduler_t::clear_quota(std::string group)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_groups[group].usage.quota = std::nullopt;
+}
+
+auto DSS::scheduler_t::group_usage(std::string group) -> DSS::group_usage_t
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto found = m_groups.find(group);
+	if (found == m_groups.end())
+	{
+		return {};
+	}
+
+	return found->second.usage;
+}
+
+auto DSS::scheduler_t::all_group_usage() -> std::map<std::string, DSS::group_usage_t>
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	std::map<std::string, DSS::group_usage_t> res = {};
+	for (auto &[name, group] : m_groups)
+	{
+		res[name] = group.usage;
+	}
+
+	return res;
+}
+
+auto DSS::scheduler_t::exhausted(group_t &group, DSS::sched_clock_t::time_point now) -> bool
+{
+	if (group.usage.quota.has_value() == false)
+	{
+		return false;
+	}
+
+	const quota_t &quota = group.usage.quota.value();
+	if (now >= group.window_start + quota.window)
+	{
+		group.window_start = now;
+		group.usage.window_time = std::chrono::nanoseconds(0);
+	}
+
+	return group.usage.window_time >= quota.budget;
+}
+
+auto DSS::scheduler_t::pick(std::optional<DSS::sched_clock_t::time_point> &wakeup) -> slot_t *
+{
+	slot_t *res = nullptr;
+	slot_t *deprioritised = nullptr;
+	DSS::sched_clock_t::time_point now = DSS::sched_clock_t::now();
+
+	for (auto &[id, slot] : m_slots)
+	{
+		if (slot.running == true || slot.jobs.empty() == true)
+		{
+			continue;
+		}
+
+		group_t &group = m_groups[slot.group];
+		if (exhausted(group, now) == true)
+		{
+			if (slot.jobs.front().throttled == false)
+			{
+				slot.jobs.front().throttled = true;
+				group.usage.throttled++;
+			}
+
+			if (group.usage.quota.value().hard == true)
+			{
+				DSS::sched_clock_t::time_point refill = group.window_start + group.usage.quota.value().window;
+				if (wakeup.has_value() == false || refill < wakeup.value())
+				{
+					wakeup = refill;
+				}
+				continue;
+			}
+
+			if (deprioritised == nullptr || slot.jobs.front().deadline < deprioritised->jobs.front().deadline)
+			{
+				deprioritised = &slot;
+			}
+			continue;
+		}
+
+		if (res == nullptr || slot.jobs.front().deadline < res->jobs.front().deadline)
+		{
+			res = &slot;
+		}
+	}
+
+	if (res == nullptr)
+	{
+		return deprioritised;
+	}
+
+	return res;
+}
+
+void DSS::scheduler_t::worker_loop()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	while (true)
+	{
+		std::optional<DSS::sched_clock_t::time_point> wakeup = std::nullopt;
+		slot_t *slot = pick(wakeup);
+
+		if (slot == nullptr)
+		{
+			if (m_stopping == true && m_pending == 0)
+			{
+				return;
+			}
+
+			if (wakeup.has_value() == true)
+			{
+				m_cv.wait_until(lock, wakeup.value());
+				continue;
+			}
+
+			m_cv.wait(lock);
+			continue;
+		}
+
+		job_t job = std::move(slot->jobs.front());
+		slot->jobs.pop_front();
+		slot->stats.pending--;
+		slot->running = true;
+		m_pending--;
+
+		std::shared_ptr<DSS::executor_t> executor = slot->executor;
+
+		lock.unlock();
+		std::chrono::nanoseconds cpu_start = dss_utils::thread_cpu_now();
+		executor->exec(std::move(job.task));
+		std::chrono::nanoseconds cpu_time = dss_utils::thread_cpu_now() - cpu_start;
+		bool missed = DSS::sched_clock_t::now() > job.deadline;
+		lock.lock();
+
+		// Slots are never erased, so the pointer remains valid
+		slot->running = false;
+		slot->stats.completed++;
+		slot->stats.cpu_time += cpu_time;
+		if (missed == true)
+		{
+			slot->stats.deadline_misses++;
+			m_total_misses++;
+		}
+
+		group_t &group = m_groups[slot->group];
+		group.usage.cpu_time += cpu_time;
+		group.usage.window_time += cpu_time;
+
+		job.result.set_value(0);
+
+		// The executor may have more work for another worker, and
+		// stopping workers wait for the last task to complete
+		if (slot->jobs.empty() == false || m_stopping == true)
+		{
+			m_cv.notify_all();
+		}
+	}
+}
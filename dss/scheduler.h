@@ -0,0 +1,286 @@
+/**
+ * This file contains the environment scheduler, which shares a
+ * fixed amount of worker threads between every executor of an
+ * environment.
+ *
+ * Work is picked earliest-deadline-first. Real-time executors
+ * declare a period and a budget, and are only admitted while the
+ * set of real-time executors remains schedulable.
+ */
+
+#ifndef H_SCHEDULER
+#define H_SCHEDULER
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+
+#include "runtime.h"
+
+namespace DSS
+{
+
+/**
+ * Relative deadline of tasks submitted to executors which
+ * have not been admitted as real-time executors.
+ */
+const std::chrono::nanoseconds DEFAULT_RELATIVE_DEADLINE = std::chrono::seconds(1);
+
+/**
+ * Parameters of a real-time executor
+ */
+struct rt_params_t
+{
+	/**
+	 * The minimum time between two tasks of the executor
+	 */
+	std::chrono::nanoseconds period = std::chrono::nanoseconds(0);
+
+	/**
+	 * The worst-case execution time of one task of the executor
+	 */
+	std::chrono::nanoseconds budget = std::chrono::nanoseconds(0);
+
+	/**
+	 * Time after submission by which a task must be complete.
+	 * Zero implies the period.
+	 */
+	std::chrono::nanoseconds deadline = std::chrono::nanoseconds(0);
+};
+
+/**
+ * Per-executor scheduling statistics
+ */
+struct sched_stats_t
+{
+	std::uint64_t completed = 0;
+	std::uint64_t deadline_misses = 0;
+	std::size_t pending = 0;
+
+	/**
+	 * Worker thread CPU time spent executing the executor
+	 */
+	std::chrono::nanoseconds cpu_time = std::chrono::nanoseconds(0);
+};
+
+/**
+ * Executors are assigned to this group unless stated otherwise
+ */
+const std::string DEFAULT_GROUP = "default";
+
+/**
+ * CPU quota of an executor group. Every `window`, the executors
+ * of the group may consume `budget` of worker CPU time.
+ */
+struct quota_t
+{
+	std::chrono::nanoseconds budget = std::chrono::nanoseconds(0);
+	std::chrono::nanoseconds window = std::chrono::milliseconds(100);
+
+	/**
+	 * Exhausted groups are throttled (not run until the next window)
+	 * if true, and otherwise only deprioritised (run when no other
+	 * group has work).
+	 */
+	bool hard = false;
+};
+
+/**
+ * CPU usage of an executor group
+ */
+struct group_usage_t
+{
+	std::chrono::nanoseconds cpu_time = std::chrono::nanoseconds(0);
+
+	/**
+	 * CPU time consumed within the current quota window
+	 */
+	std::chrono::nanoseconds window_time = std::chrono::nanoseconds(0);
+
+	/**
+	 * The amount of tasks of the group which were held back because the
+	 * group had exhausted its quota. A task counts once, however many
+	 * scheduling passes hold it back.
+	 */
+	std::uint64_t throttled = 0;
+
+	std::optional<quota_t> quota = std::nullopt;
+};
+
+class scheduler_t
+{
+public:
+	scheduler_t() = default;
+	~scheduler_t() { stop(); }
+
+	scheduler_t(const scheduler_t &) = delete;
+	scheduler_t &operator=(const scheduler_t &) = delete;
+
+	/**
+	 * Starts the worker threads. Does nothing if they are already running.
+	 *
+	 * @param workers The amount of worker threads
+	 */
+	void start(std::size_t workers);
+
+	/**
+	 * Stops the worker threads after every pending task is complete.
+	 */
+	void stop();
+
+	/**
+	 * Admits an executor as a real-time executor.
+	 *
+	 * The executor is rejected if admitting it would overcommit
+	 * the workers. Global EDF on `m` workers is guaranteed to meet
+	 * every deadline while the total utilization U does not exceed
+	 * m - (m - 1) * u_max (Goossens, Funk and Baruah).
+	 *
+	 * Executors are always rejected before `start`, as there are no
+	 * workers to guarantee anything on yet.
+	 *
+	 * @return Whether the executor was admitted
+	 */
+	auto admit(std::shared_ptr<executor_t> executor, rt_params_t params) -> bool;
+
+	/**
+	 * Removes the real-time parameters of an executor. Its
+	 * utilization is released.
+	 */
+	void release(run_id_t id);
+
+	/**
+	 * Queues a script for an executor. Tasks of one executor always run
+	 * in submission order, and an executor never runs on two workers at once.
+	 *
+	 * @param deadline The absolute deadline of the task. If not provided, the
+	 * deadline is derived from the executor's real-time parameters (or
+	 * `DEFAULT_RELATIVE_DEADLINE` for other executors).
+	 *
+	 * @return A future receiving the result of the task
+	 */
+	auto submit(std::shared_ptr<executor_t> executor, task_t task, std::optional<deadline_t> deadline = std::nullopt)
+		-> std::future<return_type_t>;
+
+	/**
+	 * @return The statistics of an executor. Empty if the executor
+	 * was never submitted to.
+	 */
+	auto stats(run_id_t id) -> sched_stats_t;
+
+	/**
+	 * Assigns an executor to a group. Quotas apply to groups as a whole.
+	 */
+	void set_group(run_id_t id, std::string group);
+
+	/**
+	 * Sets the CPU quota of a group. Groups without a quota are unlimited.
+	 */
+	void set_quota(std::string group, quota_t quota);
+
+	/**
+	 * Removes the CPU quota of a group.
+	 */
+	void clear_quota(std::string group);
+
+	/**
+	 * @return The CPU usage of a group
+	 */
+	auto group_usage(std::string group) -> group_usage_t;
+
+	/**
+	 * @return The usage of every group, by name
+	 */
+	auto all_group_usage() -> std::map<std::string, group_usage_t>;
+
+	/**
+	 * @return Deadline misses across every executor
+	 */
+	auto total_deadline_misses() -> std::uint64_t;
+
+	/**
+	 * @return The utilization of every admitted executor combined
+	 */
+	auto utilization() -> double;
+
+	/**
+	 * @return The amount of tasks which are waiting for a worker
+	 */
+	auto queue_depth() -> std::size_t;
+
+	auto worker_count() -> std::size_t { return m_workers.size(); }
+
+private:
+	struct job_t
+	{
+		task_t task;
+		deadline_t deadline;
+		std::promise<return_type_t> result;
+
+		/**
+		 * Whether the task was already counted as throttled
+		 */
+		bool throttled = false;
+	};
+
+	struct slot_t
+	{
+		std::shared_ptr<executor_t> executor = nullptr;
+		std::deque<job_t> jobs = {};
+		bool running = false;
+		std::optional<rt_params_t> rt = std::nullopt;
+		sched_stats_t stats = {};
+		std::string group = DEFAULT_GROUP;
+	};
+
+	struct group_t
+	{
+		group_usage_t usage = {};
+		sched_clock_t::time_point window_start = {};
+	};
+
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	bool m_stopping = false;
+
+	std::vector<std::thread> m_workers;
+
+	std::map<run_id_t, slot_t> m_slots;
+
+	std::map<std::string, group_t> m_groups;
+
+	/**
+	 * Amount of jobs across every slot
+	 */
+	std::size_t m_pending = 0;
+
+	std::uint64_t m_total_misses = 0;
+
+	void worker_loop();
+
+	/**
+	 * Finds the idle executor whose head task has the earliest deadline.
+	 * Executors of groups which exhausted their quota are only picked if
+	 * no other executor has work (or never, for hard quotas).
+	 *
+	 * Expects `m_mutex` to be held.
+	 *
+	 * @param wakeup Receives the time at which a throttled group regains
+	 * its quota, if any group was throttled
+	 */
+	auto pick(std::optional<sched_clock_t::time_point> &wakeup) -> slot_t *;
+
+	/**
+	 * Starts a new quota window for the group if the current one elapsed.
+	 *
+	 * @return Whether the group has exhausted its quota
+	 */
+	auto exhausted(group_t &group, sched_clock_t::time_point now) -> bool;
+};
+
+} // namespace DSS
+
+#endif // H_SCHEDULER
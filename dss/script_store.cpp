@@ -0,0 +1,65 @@
+#include "script_store.h"
+
+DSS::stored_script_t::stored_script_t(std::string text, std::size_t hash) : m_text(std::move(text)), m_hash(hash) {}
+
+auto DSS::stored_script_t::statements() const -> const DSS::strvec_t *
+{
+	std::call_once(m_split, [this] { m_statements = dss_utils::string_split(m_text, DSS::key::MULTILINE_DELIM); });
+	return &m_statements;
+}
+
+auto DSS::script_store_t::intern(std::string script) -> std::shared_ptr<const DSS::stored_script_t>
+{
+	std::size_t hash = std::hash<std::string_view>()(script);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto [first, last] = m_scripts.equal_range(hash);
+	for (auto it = first; it != last; it++)
+	{
+		std::shared_ptr<const DSS::stored_script_t> stored = it->second.lock();
+		if (stored != nullptr && stored->view() == script)
+		{
+			m_hits++;
+			return stored;
+		}
+	}
+
+	std::shared_ptr<const DSS::stored_script_t> res = std::make_shared<const DSS::stored_script_t>(std::move(script), hash);
+	m_scripts.emplace(hash, res);
+	m_misses++;
+
+	if (m_scripts.size() >= m_sweep_at)
+	{
+		sweep();
+	}
+
+	return res;
+}
+
+void DSS::script_store_t::sweep()
+{
+	std::erase_if(m_scripts, [](const auto &entry) { return entry.second.expired() == true; });
+	m_sweep_at = std::max<std::size_t>(64, m_scripts.size() * 2);
+}
+
+auto DSS::script_store_t::stats() -> DSS::script_store_stats_t
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	DSS::script_store_stats_t res = {};
+	res.hits = m_hits;
+	res.misses = m_misses;
+
+	for (const auto &[hash, script] : m_scripts)
+	{
+		std::shared_ptr<const DSS::stored_script_t> stored = script.lock();
+		if (stored != nullptr)
+		{
+			res.scripts++;
+			res.bytes += stored->view().size();
+		}
+	}
+
+	return res;
+}
@@ -0,0 +1,101 @@
+/**
+ * This file contains the script store of an environment, which
+ * shares identical scripts between tasks and executors.
+ *
+ * Scripts are content-addressed: interning a script which is already
+ * stored returns the stored buffer, so a script submitted to a whole
+ * fleet of executors is kept (and split into statements) only once.
+ * Buffers are immutable and reference-counted, and leave the store
+ * once the last task holding them completes.
+ */
+
+#ifndef H_SCRIPT_STORE
+#define H_SCRIPT_STORE
+
+#include <mutex>
+#include <unordered_map>
+
+#include "runtime.h"
+
+namespace DSS
+{
+
+class stored_script_t : public script_buffer_t
+{
+public:
+	stored_script_t(std::string text, std::size_t hash);
+
+	auto view() const -> std::string_view override { return m_text; }
+
+	/**
+	 * Split on first use, and shared by every task afterwards
+	 */
+	auto statements() const -> const strvec_t * override;
+
+	auto hash() const -> std::size_t { return m_hash; }
+
+private:
+	const std::string m_text;
+	const std::size_t m_hash;
+
+	mutable std::once_flag m_split;
+	mutable strvec_t m_statements;
+};
+
+struct script_store_stats_t
+{
+	/**
+	 * Scripts currently stored
+	 */
+	std::size_t scripts = 0;
+
+	/**
+	 * Bytes of the stored scripts
+	 */
+	std::size_t bytes = 0;
+
+	/**
+	 * Interned scripts which were already stored
+	 */
+	std::uint64_t hits = 0;
+	std::uint64_t misses = 0;
+};
+
+class script_store_t
+{
+public:
+	script_store_t() = default;
+
+	script_store_t(const script_store_t &) = delete;
+	script_store_t &operator=(const script_store_t &) = delete;
+
+	/**
+	 * @return The stored copy of `script`, which is stored first if
+	 * it is not already. Thread-safe.
+	 */
+	auto intern(std::string script) -> std::shared_ptr<const stored_script_t>;
+
+	auto stats() -> script_store_stats_t;
+
+private:
+	std::mutex m_mutex;
+
+	/**
+	 * By hash. Several scripts may share a hash, and are then told apart by their contents.
+	 */
+	std::unordered_multimap<std::size_t, std::weak_ptr<const stored_script_t>> m_scripts;
+
+	/**
+	 * Expired entries are swept once the map doubles
+	 */
+	std::size_t m_sweep_at = 64;
+
+	std::uint64_t m_hits = 0;
+	std::uint64_t m_misses = 0;
+
+	void sweep();
+};
+
+} // namespace DSS
+
+#endif // H_SCRIPT_STORE
@@ -0,0 +1,224 @@
+#include "simulation.h"
+#include "work_pool.h"
+
+DSS::simulation_t::simulation_t(DSS::environment_t &env, DSS::sim_options_t options) : m_env(env)
+{
+	m_options = options;
+	if (m_options.step.count() <= 0)
+	{
+		m_options.step = std::chrono::nanoseconds(1);
+	}
+}
+
+auto DSS::simulation_t::now() -> DSS::sched_clock_t::time_point
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_now;
+}
+
+auto DSS::simulation_t::push(release_t release) -> std::optional<DSS::timer_id_t>
+{
+	if (m_env.executor_by_id(release.id) == nullptr)
+	{
+		return std::nullopt;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	release.sequence = m_sequence++;
+	release.timer = m_next_timer++;
+	m_releases.push(std::move(release));
+
+	return m_next_timer - 1;
+}
+
+auto DSS::simulation_t::submit(DSS::run_id_t id, std::string script, std::optional<DSS::deadline_t> deadline) -> bool
+{
+	DSS::sched_clock_t::time_point current = now();
+
+	release_t release = {};
+	release.due = current;
+	release.id = id;
+	release.script = std::move(script);
+	release.deadline = deadline.value_or(current + m_options.step);
+
+	return push(std::move(release)).has_value();
+}
+
+auto DSS::simulation_t::at(DSS::run_id_t id, DSS::sched_clock_t::time_point when, std::string script) -> std::optional<DSS::timer_id_t>
+{
+	release_t release = {};
+	release.due = when;
+	release.id = id;
+	release.script = std::move(script);
+	release.deadline = when + m_options.step;
+
+	return push(std::move(release));
+}
+
+auto DSS::simulation_t::every(DSS::run_id_t id, std::chrono::nanoseconds period, std::string script, std::chrono::nanoseconds budget)
+	-> std::optional<DSS::timer_id_t>
+{
+	if (period.count() <= 0)
+	{
+		return std::nullopt;
+	}
+
+	release_t release = {};
+	release.due = now() + period;
+	release.id = id;
+	release.script = std::move(script);
+	release.deadline = release.due + period;
+	release.period = period;
+	release.budget = budget;
+
+	return push(std::move(release));
+}
+
+void DSS::simulation_t::cancel(DSS::timer_id_t timer)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_cancelled.insert(timer);
+}
+
+void DSS::simulation_t::step()
+{
+	/**
+	 * The work of one executor within the step
+	 */
+	struct lane_t
+	{
+		std::shared_ptr<DSS::executor_t> executor = nullptr;
+		std::vector<release_t> releases = {};
+		DSS::sched_clock_t::time_point busy_until = {};
+		DSS::sim_stats_t stats = {};
+	};
+
+	// Ordered by RunID, so results are merged in the same order on every run
+	std::map<DSS::run_id_t, lane_t> lanes = {};
+	DSS::sched_clock_t::time_point start = {};
+	DSS::sched_clock_t::time_point end = {};
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		start = m_now;
+		end = m_now + m_options.step;
+
+		while (m_releases.empty() == false && m_releases.top().due < end)
+		{
+			release_t release = m_releases.top();
+			m_releases.pop();
+
+			auto cancelled = m_cancelled.find(release.timer);
+			if (cancelled != m_cancelled.end())
+			{
+				m_cancelled.erase(cancelled);
+				continue;
+			}
+
+			if (release.period.count() > 0)
+			{
+				release_t next = release;
+				next.due += release.period;
+				next.deadline = next.due + release.period;
+				next.sequence = m_sequence++;
+				m_releases.push(std::move(next));
+			}
+
+			lane_t &lane = lanes[release.id];
+			lane.releases.push_back(std::move(release));
+		}
+
+		for (auto &[id, lane] : lanes)
+		{
+			lane.busy_until = std::max(m_busy_until[id], start);
+		}
+	}
+
+	for (auto &[id, lane] : lanes)
+	{
+		lane.executor = m_env.executor_by_id(id);
+	}
+
+	std::vector<DSS::work_pool_t::work_t> work = {};
+	for (auto &[id, lane] : lanes)
+	{
+		lane_t *current = &lane;
+		std::chrono::nanoseconds statement_cost = m_options.statement_cost;
+
+		work.push_back([current, statement_cost] {
+			for (release_t &release : current->releases)
+			{
+				DSS::sched_clock_t::time_point begin = std::max(current->busy_until, release.due);
+
+				std::uint64_t before = current->executor->get_cpu_usage().statements;
+				current->executor->exec(std::move(release.script));
+				std::chrono::nanoseconds cost = statement_cost * std::int64_t(current->executor->get_cpu_usage().statements - before);
+
+				current->busy_until = begin + cost;
+				current->stats.tasks++;
+				if (current->busy_until > release.deadline)
+				{
+					current->stats.deadline_misses++;
+				}
+				if (release.budget.count() > 0 && cost > release.budget)
+				{
+					current->stats.budget_overruns++;
+				}
+			}
+		});
+	}
+
+	m_env.get_work_pool().run_all(work);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	for (auto &[id, lane] : lanes)
+	{
+		m_busy_until[id] = lane.busy_until;
+		m_stats.tasks += lane.stats.tasks;
+		m_stats.deadline_misses += lane.stats.deadline_misses;
+		m_stats.budget_overruns += lane.stats.budget_overruns;
+	}
+
+	m_stats.steps++;
+	m_now = end;
+}
+
+void DSS::simulation_t::run_for(std::chrono::nanoseconds duration)
+{
+	DSS::sched_clock_t::time_point until = now() + duration;
+
+	while (true)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			if (m_now >= until)
+			{
+				return;
+			}
+
+			if (m_releases.empty() == true || m_releases.top().due >= until)
+			{
+				m_now = until;
+				return;
+			}
+
+			// Jump to the step of the next release
+			std::chrono::nanoseconds idle = m_releases.top().due - m_now;
+			if (idle >= m_options.step)
+			{
+				m_now += (idle / m_options.step) * m_options.step;
+			}
+		}
+
+		step();
+	}
+}
+
+auto DSS::simulation_t::stats() -> DSS::sim_stats_t
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
@@ -0,0 +1,175 @@
+/**
+ * This file contains the simulation driver, which runs the executors
+ * of an environment against a simulated clock.
+ *
+ * Time only advances in steps. Within a step, every executor with work
+ * due runs it on the work pool of the environment, in parallel, and the
+ * step ends once every executor is done (lockstep). The cost of a task is
+ * simulated from the amount of statements it dispatched, so deadlines and
+ * budgets are evaluated deterministically, and steps without any work due
+ * are skipped instead of waited for.
+ */
+
+#ifndef H_SIMULATION
+#define H_SIMULATION
+
+#include <map>
+#include <mutex>
+#include <queue>
+#include <set>
+
+#include "runtime.h"
+
+namespace DSS
+{
+
+struct sim_options_t
+{
+	/**
+	 * Simulated time advanced by each step. Work is released at the
+	 * start of the step its due time falls into.
+	 */
+	std::chrono::nanoseconds step = std::chrono::milliseconds(1);
+
+	/**
+	 * Simulated cost of each statement dispatched by a task
+	 */
+	std::chrono::nanoseconds statement_cost = std::chrono::microseconds(1);
+};
+
+struct sim_stats_t
+{
+	/**
+	 * Steps which ran work. Idle steps are skipped.
+	 */
+	std::uint64_t steps = 0;
+
+	std::uint64_t tasks = 0;
+
+	/**
+	 * Tasks which completed (in simulated time) after their deadline
+	 */
+	std::uint64_t deadline_misses = 0;
+
+	/**
+	 * Timer tasks which cost more than their budget
+	 */
+	std::uint64_t budget_overruns = 0;
+};
+
+typedef std::uint64_t timer_id_t;
+
+class simulation_t
+{
+public:
+	/**
+	 * @note The environment must outlive the simulation. Executors
+	 * should not be driven by anything else (e.g. the scheduler)
+	 * while the simulation runs.
+	 */
+	simulation_t(environment_t &env, sim_options_t options = sim_options_t());
+
+	simulation_t(const simulation_t &) = delete;
+	simulation_t &operator=(const simulation_t &) = delete;
+
+	/**
+	 * @return The simulated time, which starts at the epoch of `sched_clock_t`
+	 */
+	auto now() -> sched_clock_t::time_point;
+
+	/**
+	 * Runs a script at the next step. Thread-safe, including from within tasks.
+	 *
+	 * @param deadline Absolute simulated deadline, one step from now by default
+	 *
+	 * @return false if the executor does not exist
+	 */
+	auto submit(run_id_t id, std::string script, std::optional<deadline_t> deadline = std::nullopt) -> bool;
+
+	/**
+	 * Runs a script once, at a simulated time
+	 */
+	auto at(run_id_t id, sched_clock_t::time_point when, std::string script) -> std::optional<timer_id_t>;
+
+	/**
+	 * Runs a script periodically, starting one period from now. Each
+	 * release is due before the next one, and may cost up to `budget`
+	 * (zero for no budget) of simulated time.
+	 */
+	auto every(run_id_t id, std::chrono::nanoseconds period, std::string script, std::chrono::nanoseconds budget = std::chrono::nanoseconds(0))
+		-> std::optional<timer_id_t>;
+
+	/**
+	 * Stops a timer. Releases already in the current step still run.
+	 */
+	void cancel(timer_id_t timer);
+
+	/**
+	 * Runs every release due within the current step, then advances
+	 * the clock by one step.
+	 */
+	void step();
+
+	/**
+	 * Steps until the clock reaches `now() + duration`, jumping over
+	 * steps without any release.
+	 */
+	void run_for(std::chrono::nanoseconds duration);
+
+	auto stats() -> sim_stats_t;
+
+private:
+	struct release_t
+	{
+		sched_clock_t::time_point due = {};
+
+		/**
+		 * Orders releases due at the same time by submission
+		 */
+		std::uint64_t sequence = 0;
+
+		run_id_t id = 0;
+		std::string script = "";
+		deadline_t deadline = {};
+
+		/**
+		 * Zero for one-shot releases
+		 */
+		std::chrono::nanoseconds period = std::chrono::nanoseconds(0);
+		std::chrono::nanoseconds budget = std::chrono::nanoseconds(0);
+
+		timer_id_t timer = 0;
+
+		auto operator>(const release_t &other) const -> bool
+		{
+			return due != other.due ? due > other.due : sequence > other.sequence;
+		}
+	};
+
+	environment_t &m_env;
+	sim_options_t m_options;
+
+	std::mutex m_mutex;
+	std::priority_queue<release_t, std::vector<release_t>, std::greater<release_t>> m_releases;
+	std::uint64_t m_sequence = 0;
+	timer_id_t m_next_timer = 1;
+	std::set<timer_id_t> m_cancelled;
+
+	/**
+	 * Guarded by `m_mutex`, as tasks may submit while a step runs
+	 */
+	sched_clock_t::time_point m_now = {};
+
+	/**
+	 * Simulated time until which each executor is busy
+	 */
+	std::map<run_id_t, sched_clock_t::time_point> m_busy_until;
+
+	sim_stats_t m_stats;
+
+	auto push(release_t release) -> std::optional<timer_id_t>;
+};
+
+} // namespace DSS
+
+#endif // H_SIMULATION
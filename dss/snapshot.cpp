@@ -0,0 +1,271 @@
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "snapshot.h"
+#include "dss_lang.h"
+
+namespace
+{
+
+template <typename T> void put(std::string &out, T value) { out.append(reinterpret_cast<const char *>(&value), sizeof(T)); }
+
+void put_string(std::string &out, const std::string &value)
+{
+	put<std::uint32_t>(out, std::uint32_t(value.size()));
+	out.append(value);
+}
+
+/**
+ * Bounds-checked reading of an encoding
+ */
+struct reader_t
+{
+	const char *data;
+	std::size_t size;
+
+	template <typename T> auto get(T &value) -> bool
+	{
+		if (size < sizeof(T))
+		{
+			return false;
+		}
+
+		std::memcpy(&value, data, sizeof(T));
+		data += sizeof(T);
+		size -= sizeof(T);
+		return true;
+	}
+
+	auto get_string(std::string &value) -> bool
+	{
+		std::uint32_t length = 0;
+		if (get(length) == false || size < length)
+		{
+			return false;
+		}
+
+		value.assign(data, length);
+		data += length;
+		size -= length;
+		return true;
+	}
+};
+
+} // namespace
+
+void DSS::snapshot::encode_var(const DSS::var_t<std::any> &var, std::string &out)
+{
+	const std::vector<std::any> &data = var.get_data();
+
+	std::uint32_t count = 0;
+	for (const auto &element : data)
+	{
+		if (element.type() == typeid(std::string) || element.type() == typeid(std::int64_t) || element.type() == typeid(lang::alias_t))
+		{
+			count++;
+		}
+	}
+
+	put_string(out, var.get_id());
+	put<std::uint32_t>(out, count);
+
+	for (const auto &element : data)
+	{
+		if (element.type() == typeid(std::string))
+		{
+			put<std::uint8_t>(out, TAG_STRING);
+			put_string(out, std::any_cast<const std::string &>(element));
+		}
+		else if (element.type() == typeid(std::int64_t))
+		{
+			put<std::uint8_t>(out, TAG_INT);
+			put<std::int64_t>(out, std::any_cast<std::int64_t>(element));
+		}
+		else if (element.type() == typeid(lang::alias_t))
+		{
+			const lang::alias_t &alias = std::any_cast<const lang::alias_t &>(element);
+			put<std::uint8_t>(out, TAG_ALIAS);
+			put_string(out, alias.id);
+			put_string(out, alias.value);
+		}
+	}
+}
+
+auto DSS::snapshot::decode_var(const char *&data, std::size_t &size, std::string &id, std::vector<std::any> &elements) -> bool
+{
+	reader_t reader = {data, size};
+
+	std::uint32_t count = 0;
+	if (reader.get_string(id) == false || reader.get(count) == false)
+	{
+		return false;
+	}
+
+	elements.clear();
+	elements.reserve(count);
+
+	for (std::uint32_t i = 0; i < count; i++)
+	{
+		std::uint8_t tag = 0;
+		if (reader.get(tag) == false)
+		{
+			return false;
+		}
+
+		switch (tag)
+		{
+		case TAG_STRING:
+		{
+			// Decoded straight into the element, rather than through a temporary
+			std::string &value = std::any_cast<std::string &>(elements.emplace_back(std::in_place_type<std::string>));
+			if (reader.get_string(value) == false)
+			{
+				return false;
+			}
+			break;
+		}
+		case TAG_INT:
+		{
+			std::int64_t value = 0;
+			if (reader.get(value) == false)
+			{
+				return false;
+			}
+			elements.emplace_back(value);
+			break;
+		}
+		case TAG_ALIAS:
+		{
+			lang::alias_t &alias = std::any_cast<lang::alias_t &>(elements.emplace_back(std::in_place_type<lang::alias_t>));
+			if (reader.get_string(alias.id) == false || reader.get_string(alias.value) == false)
+			{
+				return false;
+			}
+			break;
+		}
+		default:
+			return false;
+		}
+	}
+
+	data = reader.data;
+	size = reader.size;
+	return true;
+}
+
+auto DSS::snapshot::encode(const DSS::vars_t &vars) -> std::string
+{
+	std::string res;
+	res.append(MAGIC, sizeof(MAGIC));
+	put<std::uint32_t>(res, FORMAT_VERSION);
+	put<std::uint32_t>(res, std::uint32_t(vars.all().size()));
+
+	for (const auto &var : vars.all())
+	{
+		encode_var(*var, res);
+	}
+
+	return res;
+}
+
+auto DSS::snapshot::decode(const char *data, std::size_t size, DSS::vars_t &vars) -> bool
+{
+	reader_t reader = {data, size};
+
+	if (size < sizeof(MAGIC) || std::memcmp(data, MAGIC, sizeof(MAGIC)) != 0)
+	{
+		return false;
+	}
+	reader.data += sizeof(MAGIC);
+	reader.size -= sizeof(MAGIC);
+
+	std::uint32_t version = 0;
+	std::uint32_t count = 0;
+	if (reader.get(version) == false || version != FORMAT_VERSION || reader.get(count) == false)
+	{
+		return false;
+	}
+
+	DSS::vars_t res = DSS::vars_t();
+	res.reserve(count);
+	std::string id;
+	std::vector<std::any> elements;
+
+	for (std::uint32_t i = 0; i < count; i++)
+	{
+		if (decode_var(reader.data, reader.size, id, elements) == false)
+		{
+			return false;
+		}
+
+		res.init_var(id, std::move(elements));
+	}
+
+	vars = std::move(res);
+	return true;
+}
+
+auto DSS::snapshot::save(DSS::executor_t &executor, const std::string &path) -> bool
+{
+	std::string encoded = encode(executor.get_vars());
+	std::string temporary = path + ".tmp";
+
+	int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	std::size_t written = 0;
+	while (written < encoded.size())
+	{
+		ssize_t res = write(fd, encoded.data() + written, encoded.size() - written);
+		if (res < 0)
+		{
+			close(fd);
+			return false;
+		}
+		written += std::size_t(res);
+	}
+
+	bool synced = fsync(fd) == 0;
+	close(fd);
+
+	return synced == true && std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+auto DSS::snapshot::load(DSS::executor_t &executor, const std::string &path) -> bool
+{
+	int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	struct stat info = {};
+	if (fstat(fd, &info) != 0 || info.st_size <= 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	std::size_t size = std::size_t(info.st_size);
+	void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (mapped == MAP_FAILED)
+	{
+		return false;
+	}
+
+	madvise(mapped, size, MADV_SEQUENTIAL);
+	bool res = decode(static_cast<const char *>(mapped), size, executor.get_vars());
+	munmap(mapped, size);
+
+	return res;
+}
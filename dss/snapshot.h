@@ -0,0 +1,85 @@
+/**
+ * This file contains executor snapshots: a compact, versioned
+ * binary image of an executor's variables (aliases and the automatic
+ * preprocessor list included).
+ *
+ * Restoring a snapshot maps the file and decodes it in place, which
+ * is far faster than replaying the scripts that built the variables.
+ */
+
+#ifndef H_SNAPSHOT
+#define H_SNAPSHOT
+
+#include "runtime.h"
+
+namespace DSS
+{
+namespace snapshot
+{
+
+const char MAGIC[4] = {'D', 'S', 'S', 'S'};
+
+/**
+ * Incremented whenever the encoding changes. Snapshots of
+ * another version are rejected.
+ */
+const std::uint32_t FORMAT_VERSION = 1;
+
+/**
+ * Tags of the element types which may be encoded.
+ * Elements of other types are not part of snapshots.
+ */
+enum tag_t : std::uint8_t
+{
+	TAG_STRING = 1,
+	TAG_INT = 2,
+	TAG_ALIAS = 3,
+};
+
+/**
+ * Appends the encoding of a single variable to `out`.
+ */
+void encode_var(const var_t<std::any> &var, std::string &out);
+
+/**
+ * Decodes a single variable. `elements` is reserved up front and each
+ * element is decoded in place, so decoding copies nothing; but every
+ * string and alias is still an allocation of its own, as variables hold
+ * their elements as `std::any`.
+ *
+ * @param data The encoding. Advanced past the variable on success.
+ * @param size The bytes remaining in `data`. Reduced on success.
+ *
+ * @return false if the encoding is malformed
+ */
+auto decode_var(const char *&data, std::size_t &size, std::string &id, std::vector<std::any> &elements) -> bool;
+
+/**
+ * Encodes every variable, with a header.
+ */
+auto encode(const vars_t &vars) -> std::string;
+
+/**
+ * Decodes variables previously encoded with `encode`.
+ *
+ * @return false if the data is not a snapshot of this format version
+ */
+auto decode(const char *data, std::size_t size, vars_t &vars) -> bool;
+
+/**
+ * Writes a snapshot of an executor's variables to `path`. The file is
+ * written next to `path` and renamed over it, so a crash never leaves
+ * a partial snapshot behind.
+ */
+auto save(executor_t &executor, const std::string &path) -> bool;
+
+/**
+ * Replaces an executor's variables with those of the snapshot at `path`.
+ * The executor is left untouched if the snapshot cannot be read.
+ */
+auto load(executor_t &executor, const std::string &path) -> bool;
+
+} // namespace snapshot
+} // namespace DSS
+
+#endif // H_SNAPSHOT
@@ -0,0 +1,77 @@
+/**
+ * This file contains the static tracepoints (USDT probes) of DSS,
+ * for tracers such as bpftrace, perf and SystemTap.
+ *
+ * Probes are compiled in when `sys/sdt.h` is available (systemtap-sdt-dev
+ * on Debian, systemtap-sdt-devel on Fedora), unless `DSS_NO_TRACE` is
+ * defined. An unattached probe is a single `nop` instruction; otherwise
+ * the macros expand to nothing.
+ *
+ * Every probe belongs to the `dss` provider:
+ *
+ * task__start(run_id)                   An executor starts a task
+ * task__end(run_id, status)
+ * pass__start(run_id, pass)             `pass` is "preprocessor" or "command"
+ * pass__end(run_id, pass)
+ * command__dispatch(run_id, name, line)
+ * command__return(run_id, name, status) `status` is -1 if the handler could not be called
+ * error__push(run_id, message, line)    `run_id` is -1 (`DSS::NO_RUN_ID`) outside of an executor
+ * queue__enqueue(run_id, queue, depth)  `queue` is "task", "buffer", "independent" or "scheduler"
+ *
+ * For example: bpftrace -e 'usdt:./DeepSeaShell:dss:command__dispatch { @[str(arg1)] = count(); }'
+ */
+
+#ifndef H_TRACE
+#define H_TRACE
+
+#if !defined(DSS_NO_TRACE) && __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define DSS_TRACING 1
+#else
+#define DSS_TRACING 0
+#endif
+
+#if DSS_TRACING == 1
+
+#define DSS_TRACE_TASK_START(run_id) DTRACE_PROBE1(dss, task__start, run_id)
+#define DSS_TRACE_TASK_END(run_id, status) DTRACE_PROBE2(dss, task__end, run_id, status)
+#define DSS_TRACE_PASS_START(run_id, pass) DTRACE_PROBE2(dss, pass__start, run_id, pass)
+#define DSS_TRACE_PASS_END(run_id, pass) DTRACE_PROBE2(dss, pass__end, run_id, pass)
+#define DSS_TRACE_COMMAND_DISPATCH(run_id, name, line) DTRACE_PROBE3(dss, command__dispatch, run_id, name, line)
+#define DSS_TRACE_COMMAND_RETURN(run_id, name, status) DTRACE_PROBE3(dss, command__return, run_id, name, status)
+#define DSS_TRACE_ERROR_PUSH(run_id, message, line) DTRACE_PROBE3(dss, error__push, run_id, message, line)
+#define DSS_TRACE_QUEUE_ENQUEUE(run_id, queue, depth) DTRACE_PROBE3(dss, queue__enqueue, run_id, queue, depth)
+
+#else
+
+#define DSS_TRACE_TASK_START(run_id)
+#define DSS_TRACE_TASK_END(run_id, status)
+#define DSS_TRACE_PASS_START(run_id, pass)
+#define DSS_TRACE_PASS_END(run_id, pass)
+#define DSS_TRACE_COMMAND_DISPATCH(run_id, name, line)
+#define DSS_TRACE_COMMAND_RETURN(run_id, name, status)
+#define DSS_TRACE_ERROR_PUSH(run_id, message, line)
+#define DSS_TRACE_QUEUE_ENQUEUE(run_id, queue, depth)
+
+#endif
+
+namespace DSS
+{
+namespace trace
+{
+
+/**
+ * Names of passes and queues, passed to probes
+ */
+const char *const PASS_PREPROCESSOR = "preprocessor";
+const char *const PASS_COMMAND = "command";
+
+const char *const QUEUE_TASK = "task";
+const char *const QUEUE_BUFFER = "buffer";
+const char *const QUEUE_INDEPENDENT = "independent";
+const char *const QUEUE_SCHEDULER = "scheduler";
+
+} // namespace trace
+} // namespace DSS
+
+#endif // H_TRACE
@@ -0,0 +1,352 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <csignal>
+#include <cstring>
+
+#include <execinfo.h>
+#include <pthread.h>
+
+#include "watchdog.h"
+
+namespace
+{
+
+/**
+ * Longest script recorded with an incident
+ */
+const std::size_t TASK_EXCERPT = 256;
+
+/**
+ * A call in progress
+ */
+struct frame_t
+{
+	bool reported = false;
+
+	DSS::sched_clock_t::time_point start = {};
+
+	/**
+	 * Valid while the frame is in use, as the call outlives its pre-dispatch hook
+	 */
+	const DSS::dispatch_t *dispatch = nullptr;
+
+	/**
+	 * The beginning of the task's script. Copied by the dispatching
+	 * thread, as the script may change (through `alias`) while it runs.
+	 */
+	std::array<char, TASK_EXCERPT> excerpt = {};
+	std::size_t excerpt_size = 0;
+};
+
+/**
+ * The commands a thread is currently dispatching
+ */
+struct call_slot_t
+{
+	std::mutex mutex;
+
+	/**
+	 * Calls in progress, innermost last, as a handler may run a script
+	 * itself. Only the first `depth` are in use; the rest are kept for reuse.
+	 */
+	std::vector<frame_t> frames;
+	std::size_t depth = 0;
+
+	pthread_t thread = {};
+};
+
+const int STACK_SIGNAL = SIGURG;
+const int MAX_FRAMES = 64;
+
+/**
+ * Written by the signal handler of the interrupted thread.
+ * Only one stack is captured at a time.
+ */
+std::mutex g_stack_mutex;
+void *g_frames[MAX_FRAMES];
+std::atomic<int> g_frame_count = -1;
+
+void stack_handler(int)
+{
+	g_frame_count.store(backtrace(g_frames, MAX_FRAMES), std::memory_order_release);
+}
+
+auto capture_stack(pthread_t thread) -> DSS::strvec_t
+{
+	std::lock_guard<std::mutex> lock(g_stack_mutex);
+
+	g_frame_count.store(-1, std::memory_order_relaxed);
+	if (pthread_kill(thread, STACK_SIGNAL) != 0)
+	{
+		return {};
+	}
+
+	int count = -1;
+	for (int i = 0; i < 100 && count < 0; i++)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		count = g_frame_count.load(std::memory_order_acquire);
+	}
+
+	if (count <= 0)
+	{
+		return {};
+	}
+
+	DSS::strvec_t res = {};
+	char **symbols = backtrace_symbols(g_frames, count);
+	if (symbols == nullptr)
+	{
+		return res;
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		res.push_back(symbols[i]);
+	}
+	free(symbols);
+
+	return res;
+}
+
+} // namespace
+
+struct DSS::watchdog_t::state_t
+{
+	std::mutex mutex;
+	std::condition_variable wake;
+	bool stopping = false;
+	bool running = false;
+
+	std::vector<std::shared_ptr<call_slot_t>> slots;
+
+	std::deque<DSS::incident_t> incidents;
+	std::uint64_t total = 0;
+
+	/**
+	 * @return The slot of the calling thread, created on first use
+	 */
+	auto slot() -> call_slot_t &
+	{
+		thread_local std::vector<std::pair<const state_t *, std::shared_ptr<call_slot_t>>> t_slots = {};
+
+		for (const auto &[state, slot] : t_slots)
+		{
+			if (state == this)
+			{
+				return *slot;
+			}
+		}
+
+		std::shared_ptr<call_slot_t> res = std::make_shared<call_slot_t>();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			slots.push_back(res);
+		}
+		t_slots.emplace_back(this, res);
+
+		return *res;
+	}
+};
+
+namespace
+{
+
+std::mutex g_installed_mutex;
+std::weak_ptr<DSS::watchdog_t::state_t> g_installed;
+
+} // namespace
+
+DSS::watchdog_t::watchdog_t(DSS::watchdog_options_t options)
+{
+	m_options = options;
+	m_state = std::make_shared<state_t>();
+}
+
+DSS::watchdog_t::~watchdog_t()
+{
+	if (m_thread.joinable() == true)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_state->mutex);
+			m_state->stopping = true;
+			m_state->running = false;
+		}
+		m_state->wake.notify_all();
+		m_thread.join();
+	}
+
+	if (m_handler_installed == true)
+	{
+		sigaction(STACK_SIGNAL, &m_previous_action, nullptr);
+	}
+}
+
+void DSS::watchdog_t::watch(DSS::environment_t &env)
+{
+	std::shared_ptr<state_t> state = m_state;
+
+	env.add_pre_dispatch_hook([state](const DSS::dispatch_t &call) -> std::optional<DSS::return_type_t> {
+		call_slot_t &slot = state->slot();
+
+		// The task outlives every call made while executing it
+		DSS::task_t *task = call.executor == nullptr ? nullptr : call.executor->get_current_task();
+		std::string_view script = task == nullptr ? std::string_view() : task->view();
+
+		std::lock_guard<std::mutex> lock(slot.mutex);
+
+		if (slot.depth == slot.frames.size())
+		{
+			slot.frames.emplace_back();
+		}
+		frame_t &frame = slot.frames[slot.depth++];
+
+		frame.reported = false;
+		frame.start = DSS::sched_clock_t::now();
+		frame.dispatch = &call;
+		frame.excerpt_size = std::min(script.size(), TASK_EXCERPT);
+		std::memcpy(frame.excerpt.data(), script.data(), frame.excerpt_size);
+		slot.thread = pthread_self();
+
+		return std::nullopt;
+	});
+
+	env.add_post_dispatch_hook([state](const DSS::dispatch_t &call) {
+		call_slot_t &slot = state->slot();
+		std::lock_guard<std::mutex> lock(slot.mutex);
+
+		// Calls whose pre-dispatch hooks were skipped (by an earlier hook's status) have no frame
+		if (slot.depth > 0 && slot.frames[slot.depth - 1].dispatch == &call)
+		{
+			slot.frames[--slot.depth].dispatch = nullptr;
+		}
+	});
+
+	if (m_options.stack_traces == true && m_handler_installed == false)
+	{
+		// The first call may allocate, which is not safe in a signal handler
+		void *frame = nullptr;
+		backtrace(&frame, 1);
+
+		struct sigaction action = {};
+		action.sa_handler = stack_handler;
+		action.sa_flags = SA_RESTART;
+		sigemptyset(&action.sa_mask);
+		m_handler_installed = sigaction(STACK_SIGNAL, &action, &m_previous_action) == 0;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(g_installed_mutex);
+		g_installed = m_state;
+	}
+
+	if (m_thread.joinable() == false)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_state->mutex);
+			m_state->running = true;
+		}
+		m_thread = std::thread(&DSS::watchdog_t::watch_loop, this);
+	}
+}
+
+void DSS::watchdog_t::watch_loop()
+{
+	std::unique_lock<std::mutex> lock(m_state->mutex);
+
+	while (m_state->stopping == false)
+	{
+		m_state->wake.wait_for(lock, m_options.interval, [this] { return m_state->stopping == true; });
+
+		std::vector<std::shared_ptr<call_slot_t>> slots = m_state->slots;
+		lock.unlock();
+
+		std::vector<DSS::incident_t> found = {};
+		DSS::sched_clock_t::time_point now = DSS::sched_clock_t::now();
+
+		for (auto &slot : slots)
+		{
+			std::lock_guard<std::mutex> slot_lock(slot->mutex);
+
+			for (std::size_t i = 0; i < slot->depth; i++)
+			{
+				frame_t &frame = slot->frames[i];
+				if (frame.reported == true || now - frame.start < m_options.threshold)
+				{
+					continue;
+				}
+				frame.reported = true;
+
+				const DSS::dispatch_t &call = *frame.dispatch;
+				DSS::incident_t incident = {};
+				incident.run_id = call.run_id;
+				incident.command = call.command->get_name();
+				incident.args.assign(call.args.begin(), call.args.end());
+				incident.line = call.line;
+				incident.elapsed = now - frame.start;
+				incident.task.assign(frame.excerpt.data(), frame.excerpt_size);
+
+				if (m_options.stack_traces == true)
+				{
+					incident.stack = capture_stack(slot->thread);
+				}
+
+				found.push_back(std::move(incident));
+			}
+		}
+
+		lock.lock();
+
+		for (auto &incident : found)
+		{
+			incident.id = m_state->total++;
+			m_state->incidents.push_back(std::move(incident));
+
+			while (m_state->incidents.size() > m_options.capacity)
+			{
+				m_state->incidents.pop_front();
+			}
+		}
+	}
+}
+
+auto DSS::watchdog_t::incidents() -> std::vector<DSS::incident_t>
+{
+	std::lock_guard<std::mutex> lock(m_state->mutex);
+	return std::vector<DSS::incident_t>(m_state->incidents.begin(), m_state->incidents.end());
+}
+
+auto DSS::watchdog_t::total() -> std::uint64_t
+{
+	std::lock_guard<std::mutex> lock(m_state->mutex);
+	return m_state->total;
+}
+
+void DSS::watchdog_t::clear()
+{
+	std::lock_guard<std::mutex> lock(m_state->mutex);
+	m_state->incidents.clear();
+}
+
+auto DSS::watchdog_t::installed_incidents() -> std::optional<std::vector<DSS::incident_t>>
+{
+	std::shared_ptr<state_t> state = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(g_installed_mutex);
+		state = g_installed.lock();
+	}
+
+	if (state == nullptr)
+	{
+		return std::nullopt;
+	}
+
+	std::lock_guard<std::mutex> lock(state->mutex);
+	if (state->running == false)
+	{
+		return std::nullopt;
+	}
+
+	return std::vector<DSS::incident_t>(state->incidents.begin(), state->incidents.end());
+}
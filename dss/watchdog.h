@@ -0,0 +1,145 @@
+/**
+ * This file contains the slow-command watchdog.
+ *
+ * Once it watches an environment, the watchdog tracks the command
+ * each thread is currently dispatching (through dispatch hooks). A
+ * background thread records an incident for every call which runs
+ * for longer than a threshold, while it is still running, so that
+ * stalls leave evidence behind.
+ */
+
+#ifndef H_WATCHDOG
+#define H_WATCHDOG
+
+#include <condition_variable>
+#include <csignal>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "runtime.h"
+
+namespace DSS
+{
+
+struct watchdog_options_t
+{
+	/**
+	 * Calls running for longer than this are recorded
+	 */
+	std::chrono::milliseconds threshold = std::chrono::milliseconds(100);
+
+	/**
+	 * How often running calls are checked
+	 */
+	std::chrono::milliseconds interval = std::chrono::milliseconds(10);
+
+	/**
+	 * The most recent incidents kept
+	 */
+	std::size_t capacity = 64;
+
+	/**
+	 * Captures the stack of the stalled thread, by interrupting it with
+	 * `SIGURG`. Handlers must then tolerate interrupted system calls.
+	 *
+	 * @warning The watchdog takes over the process-wide `SIGURG` handler
+	 * from `watch()` until it is destroyed, so out-of-band socket data
+	 * is not reported to the previous handler meanwhile.
+	 */
+	bool stack_traces = false;
+};
+
+struct incident_t
+{
+	/**
+	 * Counts every incident since the watchdog started
+	 */
+	std::uint64_t id = 0;
+
+	run_id_t run_id = 0;
+	std::string command = "";
+	strvec_t args = {};
+	std::int64_t line = -1;
+
+	/**
+	 * The script of the task (truncated)
+	 */
+	std::string task = "";
+
+	/**
+	 * How long the call had been running when it was recorded
+	 */
+	std::chrono::nanoseconds elapsed = std::chrono::nanoseconds(0);
+
+	/**
+	 * Empty unless stack traces are enabled
+	 */
+	strvec_t stack = {};
+};
+
+class watchdog_t
+{
+public:
+	watchdog_t(watchdog_options_t options = watchdog_options_t());
+
+	/**
+	 * Stops the watchdog thread. Hooks already registered with an
+	 * environment keep working, but nothing is recorded anymore.
+	 * The `SIGURG` handler replaced for stack traces is restored.
+	 */
+	~watchdog_t();
+
+	watchdog_t(const watchdog_t &) = delete;
+	watchdog_t &operator=(const watchdog_t &) = delete;
+
+	/**
+	 * Registers dispatch hooks with the environment and starts the
+	 * watchdog thread. The watchdog also becomes the one reported
+	 * by the `incidents` command.
+	 *
+	 * @note Like every dispatch hook, this should be done while no task is running.
+	 */
+	void watch(environment_t &env);
+
+	/**
+	 * @return The most recent incidents, oldest first
+	 */
+	auto incidents() -> std::vector<incident_t>;
+
+	/**
+	 * @return The amount of incidents recorded, including those
+	 * which no longer fit the buffer
+	 */
+	auto total() -> std::uint64_t;
+
+	void clear();
+
+	/**
+	 * @return The incidents of the watchdog which most recently started
+	 * watching an environment, or std::nullopt if there is none
+	 */
+	static auto installed_incidents() -> std::optional<std::vector<incident_t>>;
+
+	/**
+	 * State shared with the dispatch hooks, which may outlive the watchdog
+	 */
+	struct state_t;
+
+private:
+	watchdog_options_t m_options;
+	std::shared_ptr<state_t> m_state;
+	std::thread m_thread;
+
+	/**
+	 * The `SIGURG` handler in place before stack traces were enabled
+	 */
+	struct sigaction m_previous_action = {};
+	bool m_handler_installed = false;
+
+	void watch_loop();
+};
+
+} // namespace DSS
+
+#endif // H_WATCHDOG
@@ -0,0 +1,174 @@
+#include "work_pool.h"
+
+namespace
+{
+
+/**
+ * The queue owned by the current thread, if it is a worker
+ */
+thread_local std::size_t t_own_queue = SIZE_MAX;
+
+} // namespace
+
+void DSS::work_pool_t::start(std::size_t workers)
+{
+	if (m_workers.empty() == false || workers == 0)
+	{
+		return;
+	}
+
+	m_stopping = false;
+	for (std::size_t i = 0; i < workers; i++)
+	{
+		m_queues.push_back(std::make_unique<queue_t>());
+	}
+	for (std::size_t i = 0; i < workers; i++)
+	{
+		m_workers.emplace_back(&DSS::work_pool_t::worker_loop, this, i);
+	}
+}
+
+void DSS::work_pool_t::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_idle_mutex);
+		m_stopping = true;
+	}
+	m_idle.notify_all();
+
+	for (auto &worker : m_workers)
+	{
+		worker.join();
+	}
+	m_workers.clear();
+	m_queues.clear();
+}
+
+void DSS::work_pool_t::execute(item_t &item)
+{
+	item.work();
+
+	// Decrement under the lock, so the waiter cannot destroy the batch before it is released
+	std::lock_guard<std::mutex> lock(item.batch->mutex);
+	if (item.batch->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+	{
+		item.batch->done.notify_all();
+	}
+}
+
+auto DSS::work_pool_t::take(std::size_t own, item_t &item) -> bool
+{
+	if (own < m_queues.size())
+	{
+		queue_t &queue = *m_queues[own];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+
+		if (queue.items.empty() == false)
+		{
+			item = std::move(queue.items.back());
+			queue.items.pop_back();
+			m_queued.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+
+	// Start stealing next to the own queue, to spread thieves out
+	std::size_t start = own < m_queues.size() ? own + 1 : 0;
+	for (std::size_t i = 0; i < m_queues.size(); i++)
+	{
+		std::size_t victim = (start + i) % m_queues.size();
+		if (victim == own)
+		{
+			continue;
+		}
+
+		queue_t &queue = *m_queues[victim];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+
+		if (queue.items.empty() == false)
+		{
+			item = std::move(queue.items.front());
+			queue.items.pop_front();
+			m_queued.fetch_sub(1, std::memory_order_relaxed);
+			m_steals.fetch_add(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void DSS::work_pool_t::run_all(std::vector<work_t> &work)
+{
+	if (work.empty() == true)
+	{
+		return;
+	}
+
+	if (m_queues.empty() == true)
+	{
+		for (auto &func : work)
+		{
+			func();
+		}
+		return;
+	}
+
+	batch_t batch = {};
+	batch.remaining.store(work.size(), std::memory_order_relaxed);
+
+	// Workers queue onto themselves (others steal), outsiders spread the items out
+	for (auto &func : work)
+	{
+		std::size_t index = t_own_queue < m_queues.size() ? t_own_queue : m_next_queue.fetch_add(1, std::memory_order_relaxed) % m_queues.size();
+
+		queue_t &queue = *m_queues[index];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.items.push_back({std::move(func), &batch});
+		m_queued.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_idle_mutex);
+	}
+	m_idle.notify_all();
+
+	// Help instead of blocking, so nested batches cannot starve the pool
+	while (batch.remaining.load(std::memory_order_acquire) > 0)
+	{
+		item_t item = {};
+		if (take(t_own_queue, item) == true)
+		{
+			execute(item);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(batch.mutex);
+		batch.done.wait_for(lock, std::chrono::milliseconds(1), [&batch] { return batch.remaining.load(std::memory_order_acquire) == 0; });
+	}
+
+	// The last item may still hold the lock
+	std::lock_guard<std::mutex> lock(batch.mutex);
+}
+
+void DSS::work_pool_t::worker_loop(std::size_t index)
+{
+	t_own_queue = index;
+
+	while (true)
+	{
+		item_t item = {};
+		if (take(index, item) == true)
+		{
+			execute(item);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_idle_mutex);
+		if (m_stopping == true)
+		{
+			return;
+		}
+		m_idle.wait(lock, [this] { return m_stopping == true || m_queued.load(std::memory_order_relaxed) > 0; });
+	}
+}
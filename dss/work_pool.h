@@ -0,0 +1,119 @@
+/**
+ * This file contains a work-stealing thread pool.
+ *
+ * Every worker owns a queue of work items. Workers take items
+ * from the back of their own queue, and steal from the front of
+ * other workers' queues once their own runs dry. Threads which
+ * wait for a batch help execute work instead of blocking, so
+ * batches may be nested (work items may submit batches).
+ */
+
+#ifndef H_WORK_POOL
+#define H_WORK_POOL
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace DSS
+{
+
+class work_pool_t
+{
+public:
+	typedef std::function<void()> work_t;
+
+	work_pool_t() = default;
+	~work_pool_t() { stop(); }
+
+	work_pool_t(const work_pool_t &) = delete;
+	work_pool_t &operator=(const work_pool_t &) = delete;
+
+	/**
+	 * Starts the worker threads. Does nothing if they are already running.
+	 */
+	void start(std::size_t workers);
+
+	/**
+	 * Stops the worker threads. Work which has not started is run by
+	 * the threads waiting for it.
+	 */
+	void stop();
+
+	/**
+	 * Runs every work item, and returns once all of them are complete.
+	 * If the pool has no workers, the items are run in order on the
+	 * calling thread.
+	 *
+	 * @param work The work items. They may run in any order, on any thread.
+	 */
+	void run_all(std::vector<work_t> &work);
+
+	auto worker_count() -> std::size_t { return m_queues.size(); }
+
+	/**
+	 * @return The amount of queued work items, not yet taken by a worker
+	 */
+	auto queued() -> std::size_t { return m_queued.load(std::memory_order_relaxed); }
+
+	/**
+	 * @return The amount of work items which were executed by
+	 * a thread other than the one they were queued to
+	 */
+	auto steals() -> std::uint64_t { return m_steals.load(std::memory_order_relaxed); }
+
+private:
+	struct batch_t
+	{
+		std::atomic<std::size_t> remaining = {0};
+		std::mutex mutex;
+		std::condition_variable done;
+	};
+
+	struct item_t
+	{
+		work_t work;
+		batch_t *batch;
+	};
+
+	struct queue_t
+	{
+		std::mutex mutex;
+		std::deque<item_t> items;
+	};
+
+	std::vector<std::unique_ptr<queue_t>> m_queues;
+	std::vector<std::thread> m_workers;
+
+	std::mutex m_idle_mutex;
+	std::condition_variable m_idle;
+	bool m_stopping = false;
+
+	/**
+	 * Items queued but not yet taken
+	 */
+	std::atomic<std::size_t> m_queued = {0};
+
+	std::atomic<std::size_t> m_next_queue = {0};
+
+	std::atomic<std::uint64_t> m_steals = {0};
+
+	void worker_loop(std::size_t index);
+
+	/**
+	 * Takes an item from the back of queue `own` (if it is a valid index),
+	 * or steals one from the front of any other queue.
+	 */
+	auto take(std::size_t own, item_t &item) -> bool;
+
+	static void execute(item_t &item);
+};
+
+} // namespace DSS
+
+#endif // H_WORK_POOL